@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <map>
+#include <string>
+#include <vector>
+#include "leptjson.h"
+#include "bench_corpus.h"
+
+/* Allocation benchmark: replaces the global operator new/delete with a
+ * counting version and reports what each lept_value operation costs in
+ * allocations, bytes and peak live heap.
+ *
+ *   leptjson_bench_alloc [--save FILE] [--check FILE] [--tolerance PCT] [file.json ...]
+ *
+ * copy is a deep copy; share takes a copy-on-write handle with share(), and
+ * first-write is the first mutable access through that handle, which
+ * clones the top-level container.
+ *
+ * --save writes the results in a form --check can later compare against,
+ * one line per row with the corpus name last, so names may hold spaces;
+ * --check exits non-zero if any count grew by more than the tolerance. */
+
+struct alloc_stats {
+	size_t count;
+	size_t bytes;
+	size_t frees;
+	size_t freed_bytes;
+	size_t live;
+	size_t peak;
+};
+
+static alloc_stats g_alloc;
+
+/* Every block carries its size in a header so delete can account for it;
+ * 16 bytes keeps the returned pointer aligned for any fundamental type. */
+static const size_t ALLOC_HEADER = 16;
+
+static void* counted_alloc(size_t n)
+{
+	char* p = (char*)malloc(n + ALLOC_HEADER);
+	if (!p)
+		return nullptr;
+	*(size_t*)p = n;
+	g_alloc.count++;
+	g_alloc.bytes += n;
+	g_alloc.live += n;
+	if (g_alloc.live > g_alloc.peak)
+		g_alloc.peak = g_alloc.live;
+	return p + ALLOC_HEADER;
+}
+
+static void counted_free(void* ptr)
+{
+	if (!ptr)
+		return;
+	char* p = (char*)ptr - ALLOC_HEADER;
+	size_t n = *(size_t*)p;
+	g_alloc.frees++;
+	g_alloc.freed_bytes += n;
+	g_alloc.live -= n;
+	free(p);
+}
+
+void* operator new(size_t n)
+{
+	void* p = counted_alloc(n);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t n)
+{
+	return operator new(n);
+}
+
+void* operator new(size_t n, const std::nothrow_t&) noexcept
+{
+	return counted_alloc(n);
+}
+
+void* operator new[](size_t n, const std::nothrow_t&) noexcept
+{
+	return counted_alloc(n);
+}
+
+void operator delete(void* p) noexcept { counted_free(p); }
+void operator delete[](void* p) noexcept { counted_free(p); }
+void operator delete(void* p, size_t) noexcept { counted_free(p); }
+void operator delete[](void* p, size_t) noexcept { counted_free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { counted_free(p); }
+
+struct op_result {
+	size_t allocs;
+	size_t bytes;
+	size_t frees;
+	size_t peak;
+};
+
+static alloc_stats begin_op()
+{
+	alloc_stats s = g_alloc;
+	g_alloc.peak = g_alloc.live;
+	return s;
+}
+
+static op_result end_op(const alloc_stats& start)
+{
+	op_result r;
+	r.allocs = g_alloc.count - start.count;
+	r.bytes = g_alloc.bytes - start.bytes;
+	r.frees = g_alloc.frees - start.frees;
+	r.peak = g_alloc.peak - start.live;
+	return r;
+}
+
+static const char* const OP_NAMES[] = { "parse", "copy", "share", "first-write", "stringify", "destroy" };
+static const int OP_COUNT = 6;
+
+static void measure(const bench_corpus& corpus, op_result res[OP_COUNT])
+{
+	alloc_stats s;
+	lept_value* v = new lept_value;
+
+	s = begin_op();
+	int ret = v->parse(corpus.json);
+	res[0] = end_op(s);
+	if (ret != LEPT_PARSE_OK)
+		fprintf(stderr, "%s: parse error %d\n", corpus.name.c_str(), ret);
+
+	s = begin_op();
+	lept_value* copy = new lept_value(*v);
+	res[1] = end_op(s);
+	delete copy;
+
+	s = begin_op();
+	lept_value* handle = new lept_value(v->share());
+	res[2] = end_op(s);
+
+	s = begin_op();
+	if (handle->get_type() == lept_type::array)
+		handle->get<lept_value::array_t>();
+	else if (handle->get_type() == lept_type::object)
+		handle->get<lept_value::object_t>();
+	res[3] = end_op(s);
+	delete handle;
+
+	s = begin_op();
+	{
+		std::string out = v->stringify();
+		res[4] = end_op(s);
+	}
+
+	s = begin_op();
+	delete v;
+	res[5] = end_op(s);
+}
+
+typedef std::map<std::string, op_result> result_map;
+
+static bool load_baseline(const char* path, result_map& baseline)
+{
+	FILE* fp = fopen(path, "r");
+	if (!fp)
+		return false;
+	char line[1024], op[32];
+	op_result r;
+	int n;
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%31s %zu %zu %zu %zu%n", op, &r.allocs, &r.bytes, &r.frees, &r.peak, &n) != 5)
+			continue;
+		/* the rest of the line, after one space, is the corpus name */
+		std::string name(line + n + (line[n] == ' '));
+		while (!name.empty() && (name.back() == '\n' || name.back() == '\r'))
+			name.pop_back();
+		baseline[name + " " + op] = r;
+	}
+	fclose(fp);
+	return true;
+}
+
+static bool exceeds(size_t actual, size_t expect, double tolerance)
+{
+	return (double)actual > (double)expect * (1.0 + tolerance / 100.0);
+}
+
+int main(int argc, char** argv)
+{
+	const char* save_path = nullptr;
+	const char* check_path = nullptr;
+	double tolerance = 5.0;
+	std::vector<bench_corpus> corpora;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--save") && i + 1 < argc)
+			save_path = argv[++i];
+		else if (!strcmp(argv[i], "--check") && i + 1 < argc)
+			check_path = argv[++i];
+		else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc)
+			tolerance = atof(argv[++i]);
+		else {
+			bench_corpus c;
+			if (!bench_load_file(argv[i], c)) {
+				fprintf(stderr, "cannot read %s\n", argv[i]);
+				return 2;
+			}
+			corpora.push_back(std::move(c));
+		}
+	}
+	if (corpora.empty())
+		corpora = bench_builtin_corpora();
+
+	result_map baseline;
+	if (check_path && !load_baseline(check_path, baseline)) {
+		fprintf(stderr, "cannot read baseline %s\n", check_path);
+		return 2;
+	}
+
+	FILE* save = save_path ? fopen(save_path, "w") : nullptr;
+	int regressions = 0;
+
+	printf("%-12s %-11s %10s %12s %10s %12s %9s %9s\n",
+		"corpus", "op", "allocs", "bytes", "frees", "peak", "B/in", "peak/in");
+	for (auto& corpus : corpora) {
+		op_result res[OP_COUNT];
+		measure(corpus, res);
+		double in = (double)corpus.json.size();
+		for (int op = 0; op < OP_COUNT; op++) {
+			const op_result& r = res[op];
+			printf("%-12s %-11s %10zu %12zu %10zu %12zu %9.2f %9.2f\n",
+				corpus.name.c_str(), OP_NAMES[op], r.allocs, r.bytes, r.frees, r.peak,
+				r.bytes / in, r.peak / in);
+			if (save)
+				fprintf(save, "%s %zu %zu %zu %zu %s\n",
+					OP_NAMES[op], r.allocs, r.bytes, r.frees, r.peak, corpus.name.c_str());
+
+			auto it = baseline.find(corpus.name + " " + OP_NAMES[op]);
+			if (it == baseline.end())
+				continue;
+			const op_result& b = it->second;
+			if (exceeds(r.allocs, b.allocs, tolerance) || exceeds(r.bytes, b.bytes, tolerance)
+				|| exceeds(r.peak, b.peak, tolerance)) {
+				fprintf(stderr, "regression: %s %s allocs %zu->%zu bytes %zu->%zu peak %zu->%zu\n",
+					corpus.name.c_str(), OP_NAMES[op], b.allocs, r.allocs, b.bytes, r.bytes, b.peak, r.peak);
+				regressions++;
+			}
+		}
+	}
+	if (save)
+		fclose(save);
+	return regressions ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+/* Corpora shared by the benchmark executables.  The built-in documents are
+ * generated deterministically so numbers are comparable between runs and
+ * machines; real files can be added on the command line. */
+
+struct bench_corpus {
+	std::string name;
+	std::string json;
+};
+
+class bench_rng {
+public:
+	explicit bench_rng(uint64_t seed) : state(seed) {}
+
+	uint32_t next()
+	{
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return (uint32_t)(state >> 33);
+	}
+
+	uint32_t range(uint32_t n) { return next() % n; }
+
+private:
+	uint64_t state;
+};
+
+static inline void bench_append_word(std::string& out, bench_rng& rng)
+{
+	static const char* const words[] = {
+		"lorem", "ipsum", "dolor", "sit", "amet", "json", "value", "parse",
+		"\\\"quoted\\\"", "tab\\there", "caf\\u00e9", "\\u4e2d\\u6587", "line\\nbreak", "path\\/to"
+	};
+	out += words[rng.range(sizeof(words) / sizeof(words[0]))];
+}
+
+/* Mostly floating point coordinates, like geographic data. */
+static inline std::string bench_make_numbers(size_t count)
+{
+	bench_rng rng(1);
+	std::string out = "[";
+	for (size_t i = 0; i < count; i++) {
+		char buf[64];
+		if (i) out += ',';
+		if (rng.range(4) == 0)
+			snprintf(buf, sizeof(buf), "%d", (int)rng.range(1000000) - 500000);
+		else
+			snprintf(buf, sizeof(buf), "[%.15g,%.15g]", rng.next() / 23860929.0 - 90.0, rng.next() / 11930464.0 - 180.0);
+		out += buf;
+	}
+	out += ']';
+	return out;
+}
+
+/* Records with many short string fields, some of them escaped. */
+static inline std::string bench_make_records(size_t count)
+{
+	bench_rng rng(2);
+	std::string out = "[";
+	for (size_t i = 0; i < count; i++) {
+		char buf[64];
+		if (i) out += ',';
+		snprintf(buf, sizeof(buf), "{\"id\":%zu,\"user\":{\"name\":\"", i);
+		out += buf;
+		bench_append_word(out, rng);
+		out += "\",\"followers\":";
+		out += std::to_string(rng.range(100000));
+		out += ",\"verified\":";
+		out += rng.range(2) ? "true" : "false";
+		out += "},\"text\":\"";
+		for (uint32_t w = 0, n = 4 + rng.range(16); w < n; w++) {
+			if (w) out += ' ';
+			bench_append_word(out, rng);
+		}
+		out += "\",\"tags\":[";
+		for (uint32_t t = 0, n = rng.range(4); t < n; t++) {
+			if (t) out += ',';
+			out += '\"';
+			bench_append_word(out, rng);
+			out += '\"';
+		}
+		out += "],\"reply_to\":null}";
+	}
+	out += ']';
+	return out;
+}
+
+/* Objects nested a few levels deep with many small containers. */
+static inline void bench_append_nested(std::string& out, bench_rng& rng, int depth)
+{
+	if (depth == 0) {
+		out += std::to_string(rng.range(1000));
+		return;
+	}
+	out += "{\"k0\":";
+	bench_append_nested(out, rng, depth - 1);
+	for (uint32_t i = 1, n = 2 + rng.range(3); i < n; i++) {
+		out += ",\"k" + std::to_string(i) + "\":[";
+		bench_append_nested(out, rng, depth - 1);
+		out += ",\"x\",1.5]";
+	}
+	out += '}';
+}
+
+static inline std::string bench_make_nested(int depth)
+{
+	bench_rng rng(3);
+	std::string out;
+	bench_append_nested(out, rng, depth);
+	return out;
+}
+
+static inline std::vector<bench_corpus> bench_builtin_corpora()
+{
+	std::vector<bench_corpus> corpora;
+	corpora.push_back({ "numbers", bench_make_numbers(50000) });
+	corpora.push_back({ "records", bench_make_records(5000) });
+	corpora.push_back({ "nested", bench_make_nested(9) });
+	return corpora;
+}
+
+static inline bool bench_load_file(const char* path, bench_corpus& corpus)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		return false;
+	std::ostringstream ss;
+	ss << in.rdbuf();
+	corpus.name = path;
+	corpus.json = ss.str();
+	return true;
+}
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "leptjson.h"
+#include "bench_corpus.h"
+
+/* Tail-latency benchmark for small messages: every thread runs
+ * parse -> field access -> stringify on its own copy of a message set and
+ * records the latency of each round trip.  Thread counts 1..N are run in
+ * turn so scaling cliffs (allocator contention, false sharing) show up as
+ * p99/p999 growth or as throughput that stops rising.
+ *
+ *   leptjson_bench_latency [--threads N] [--iterations K] [--messages M]
+ */
+
+/* Log-linear histogram: 16 sub-buckets per power of two gives ~6% resolution
+ * over the whole 64-bit range with a fixed 8KB footprint per thread. */
+class latency_histogram {
+public:
+	static const int SUB_BITS = 4;
+	static const int BUCKETS = 64 << SUB_BITS;
+
+	latency_histogram() : counts(BUCKETS, 0), total(0), peak(0) {}
+
+	void record(uint64_t ns)
+	{
+		counts[index(ns)]++;
+		total++;
+		if (ns > peak)
+			peak = ns;
+	}
+
+	void merge(const latency_histogram& h)
+	{
+		for (int i = 0; i < BUCKETS; i++)
+			counts[i] += h.counts[i];
+		total += h.total;
+		if (h.peak > peak)
+			peak = h.peak;
+	}
+
+	/* Upper bound of the bucket holding the q-th quantile. */
+	uint64_t quantile(double q) const
+	{
+		uint64_t rank = (uint64_t)(q * (double)total);
+		if (total && rank >= total)
+			rank = total - 1;
+		uint64_t seen = 0;
+		for (int i = 0; i < BUCKETS; i++) {
+			seen += counts[i];
+			if (seen > rank)
+				return upper(i);
+		}
+		return upper(BUCKETS - 1);
+	}
+
+	uint64_t count() const { return total; }
+	/* the largest latency recorded, exactly */
+	uint64_t max() const { return peak; }
+
+private:
+	std::vector<uint64_t> counts;
+	uint64_t total;
+	uint64_t peak;
+
+	static int index(uint64_t v)
+	{
+		if (v < (1u << SUB_BITS))
+			return (int)v;
+		int msb = 63 - __builtin_clzll(v);
+		int sub = (int)((v >> (msb - SUB_BITS)) & ((1u << SUB_BITS) - 1));
+		return ((msb - SUB_BITS + 1) << SUB_BITS) | sub;
+	}
+
+	static uint64_t upper(int i)
+	{
+		if (i < (1 << SUB_BITS))
+			return (uint64_t)i;
+		int msb = (i >> SUB_BITS) + SUB_BITS - 1;
+		uint64_t sub = (uint64_t)(i & ((1 << SUB_BITS) - 1));
+		return ((((uint64_t)1 << SUB_BITS) | sub) + 1) << (msb - SUB_BITS);
+	}
+};
+
+/* Messages between 0.5 and 4KB shaped like typical RPC payloads. */
+static std::vector<std::string> make_messages(size_t count)
+{
+	bench_rng rng(27);
+	std::vector<std::string> msgs;
+	for (size_t i = 0; i < count; i++) {
+		size_t target = 512 + rng.range(3584);
+		std::string m = "{\"id\":" + std::to_string(i) + ",\"method\":\"get\",\"user\":{\"name\":\"";
+		bench_append_word(m, rng);
+		m += "\",\"score\":" + std::to_string(rng.range(1000) / 7.0) + "},\"items\":[";
+		bool first = true;
+		while (m.size() + 64 < target) {
+			if (!first) m += ',';
+			first = false;
+			m += "{\"sku\":" + std::to_string(rng.range(100000)) + ",\"label\":\"";
+			bench_append_word(m, rng);
+			m += ' ';
+			bench_append_word(m, rng);
+			m += "\",\"ok\":true}";
+		}
+		m += "]}";
+		msgs.push_back(m);
+	}
+	return msgs;
+}
+
+/* one cache line each, so the counters written every iteration do not
+ * share lines between threads */
+struct alignas(64) thread_result {
+	latency_histogram hist;
+	size_t bytes = 0;
+	size_t checksum = 0;
+};
+
+static void worker(const std::vector<std::string>& msgs, size_t iterations,
+	std::atomic<int>& ready, const std::atomic<bool>& go, thread_result& res)
+{
+	typedef std::chrono::steady_clock clock;
+	ready.fetch_add(1);
+	while (!go.load(std::memory_order_acquire))
+		std::this_thread::yield();
+
+	for (size_t i = 0; i < iterations; i++) {
+		const std::string& msg = msgs[i % msgs.size()];
+		auto t0 = clock::now();
+
+		lept_value v;
+		if (v.parse(msg) != LEPT_PARSE_OK)
+			abort();
+		const lept_value& cv = v;
+		size_t touched = (size_t)cv["id"].get_integer();
+		touched += cv["user"]["name"].get_string().size();
+		touched += cv["items"].get_array_size();
+		std::string out = v.stringify();
+
+		auto t1 = clock::now();
+		res.hist.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+		res.bytes += msg.size();
+		res.checksum += touched + out.size();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned max_threads = std::thread::hardware_concurrency();
+	size_t iterations = 20000;
+	size_t message_count = 256;
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (!strcmp(argv[i], "--threads"))
+			max_threads = (unsigned)atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "--iterations"))
+			iterations = (size_t)atol(argv[i + 1]);
+		else if (!strcmp(argv[i], "--messages"))
+			message_count = (size_t)atol(argv[i + 1]);
+		else {
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+	if (max_threads == 0)
+		max_threads = 1;
+	if (message_count == 0)
+		message_count = 1;
+
+	printf("%-8s %12s %12s %10s %10s %10s %10s\n",
+		"threads", "msgs/s", "MB/s", "p50(ns)", "p99(ns)", "p999(ns)", "max(ns)");
+	for (unsigned n = 1; n <= max_threads; n++) {
+		/* each thread gets private copies so input bytes are never shared */
+		std::vector<std::vector<std::string>> inputs(n, make_messages(message_count));
+		std::vector<thread_result> results(n);
+		std::vector<std::thread> threads;
+		std::atomic<int> ready(0);
+		std::atomic<bool> go(false);
+
+		for (unsigned t = 0; t < n; t++)
+			threads.emplace_back(worker, std::cref(inputs[t]), iterations,
+				std::ref(ready), std::cref(go), std::ref(results[t]));
+		while (ready.load() != (int)n)
+			std::this_thread::yield();
+
+		auto start = std::chrono::steady_clock::now();
+		go.store(true, std::memory_order_release);
+		for (auto& th : threads)
+			th.join();
+		double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		latency_histogram all;
+		size_t bytes = 0;
+		for (auto& r : results) {
+			all.merge(r.hist);
+			bytes += r.bytes;
+		}
+		printf("%-8u %12.0f %12.2f %10llu %10llu %10llu %10llu\n", n,
+			all.count() / secs, bytes / secs / (1024.0 * 1024.0),
+			(unsigned long long)all.quantile(0.5), (unsigned long long)all.quantile(0.99),
+			(unsigned long long)all.quantile(0.999), (unsigned long long)all.max());
+	}
+	return 0;
+}
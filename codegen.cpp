@@ -0,0 +1,588 @@
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "leptjson.h"
+#include "leptjson_scan.h"
+
+/* Generates a specialized parser and serializer from a JSON Schema.
+ *
+ *   lept_codegen schema.json out.h [RootName]
+ *
+ * Every object schema with "properties" becomes a plain struct; the emitted
+ * lept_gen_read()/lept_gen_write() overloads drive lept_reader and
+ * lept_writer directly, with one switch case per member and the member's
+ * read call spelled out, so nothing is dispatched at run time.  Keys are
+ * matched by first trying the member after the last one seen, then a switch
+ * on key length.  The generated header depends only on leptjson.
+ *
+ * Understood keywords: type (a name or a list; "null" makes the member
+ * nullable), properties, required, items, title, $defs/definitions and
+ * local "$ref": "#/$defs/Name".  Anything else maps to lept_value.  Members
+ * are declared in key order, since that is how lept_value holds the schema,
+ * and missing required members fail with LEPT_PARSE_TYPE_MISMATCH. */
+
+struct gen_type {
+	enum kind_t { BOOL, INT, NUM, STR, ANY, ARRAY, STRUCT } kind;
+	bool nullable;
+	std::shared_ptr<gen_type> item;	/* ARRAY */
+	std::string name;				/* STRUCT */
+	gen_type() : kind(ANY), nullable(false) {}
+};
+
+struct gen_field {
+	std::string key;
+	std::string ident;
+	gen_type type;
+	bool required;
+};
+
+struct gen_struct {
+	std::string name;
+	std::vector<gen_field> fields;
+};
+
+static bool is_ident_char(char c, bool first)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (!first && c >= '0' && c <= '9');
+}
+
+static std::string make_ident(const std::string& s)
+{
+	static const char* reserved[] = {
+		"alignas", "alignof", "and", "auto", "bool", "break", "case", "catch", "char", "class", "const",
+		"continue", "default", "delete", "do", "double", "else", "enum", "explicit", "export", "extern",
+		"false", "float", "for", "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace",
+		"new", "not", "nullptr", "operator", "or", "private", "protected", "public", "register", "return",
+		"short", "signed", "sizeof", "static", "struct", "switch", "template", "this", "throw", "true",
+		"try", "typedef", "typename", "union", "unsigned", "using", "virtual", "void", "volatile", "while"
+	};
+	std::string id;
+	for (char c : s)
+		id.push_back(is_ident_char(c, id.empty()) ? c : '_');
+	if (id.empty() || !is_ident_char(id[0], true))
+		id.insert(id.begin(), '_');
+	for (const char* r : reserved)
+		if (id == r)
+			id.push_back('_');
+	return id;
+}
+
+/* Escapes bytes for use inside a C++ string literal. */
+static std::string c_quote(const std::string& s)
+{
+	std::string out = "\"";
+	for (unsigned char c : s) {
+		if (c == '"' || c == '\\') {
+			out.push_back('\\');
+			out.push_back((char)c);
+		}
+		else if (c < 0x20 || c >= 0x7F) {
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\%03o", c);
+			out += buf;
+		}
+		else
+			out.push_back((char)c);
+	}
+	return out + "\"";
+}
+
+/* The key as lept_writer::string() would write it. */
+static std::string json_quote(const std::string& s)
+{
+	std::string out;
+	lept_escape_string(s, 0, [&out](const char* p, size_t n) { out.append(p, n); });
+	return out;
+}
+
+static std::string tabs(int n)
+{
+	return std::string((size_t)n, '\t');
+}
+
+class lept_codegen
+{
+public:
+	std::string error;
+
+	bool load(const lept_value& schema, const std::string& root_name)
+	{
+		root = &schema;
+		gen_type t;
+		if (!resolve(schema, root_name, t))
+			return false;
+		if (t.kind != gen_type::STRUCT) {
+			error = "root schema must be an object with properties";
+			return false;
+		}
+		return true;
+	}
+
+	std::string emit(const std::string& source) const
+	{
+		std::string out;
+		out += "/* Generated by lept_codegen from " + source + "; do not edit. */\n";
+		out += "#pragma once\n\n";
+		out += "#include <string.h>\n#include <optional>\n#include <string>\n#include <string_view>\n#include <vector>\n";
+		out += "#include \"leptjson_reader.h\"\n#include \"leptjson_writer.h\"\n\n";
+		for (auto& s : structs) {
+			out += "struct " + s.name + " {\n";
+			for (auto& f : s.fields)
+				out += "\t" + field_type(f) + " " + f.ident + ";\n";
+			out += "};\n\n";
+		}
+		for (auto& s : structs) {
+			out += "inline int lept_gen_read(lept_reader& r, " + s.name + "& out);\n";
+			out += "inline void lept_gen_write(lept_writer& w, const " + s.name + "& v);\n";
+		}
+		out += "\n";
+		for (auto& s : structs) {
+			emit_key(out, s);
+			emit_read(out, s);
+			emit_write(out, s);
+			out += "inline int lept_gen_parse(std::string_view json, " + s.name + "& out)\n{\n";
+			out += "\tlept_reader r(json);\n\tint ret = lept_gen_read(r, out);\n";
+			out += "\tif (ret == LEPT_PARSE_OK)\n\t\tret = r.finish();\n\treturn ret;\n}\n\n";
+			out += "inline std::string lept_gen_stringify(const " + s.name + "& v)\n{\n";
+			out += "\tstd::string out;\n\tlept_string_sink sink(out);\n";
+			out += "\t{\n\t\tlept_writer w(sink);\n\t\tlept_gen_write(w, v);\n\t}\n\treturn out;\n}\n\n";
+		}
+		return out;
+	}
+
+private:
+	const lept_value* root;
+	std::vector<gen_struct> structs;	/* dependencies first */
+	std::map<std::string, int> state;	/* 1 while being built, 2 when done */
+	std::map<std::string, gen_type> refs;
+
+	bool resolve(const lept_value& s, const std::string& hint, gen_type& t)
+	{
+		if (s.get_type() != lept_type::object) {
+			/* true accepts anything */
+			t.kind = gen_type::ANY;
+			return true;
+		}
+		if (s.contains_key("$ref"))
+			return resolve_ref(s["$ref"], t);
+
+		std::string type;
+		if (s.contains_key("type")) {
+			const lept_value& ty = s["type"];
+			if (ty.get_type() == lept_type::string)
+				type = ty.get_string();
+			else if (ty.get_type() == lept_type::array) {
+				for (size_t i = 0; i < ty.get_array_size(); i++) {
+					const lept_value& e = ty[(int)i];
+					if (e.get_type() != lept_type::string)
+						continue;
+					if (e.get_string() == "null")
+						t.nullable = true;
+					else if (type.empty())
+						type = e.get_string();
+					else
+						type = "*";	/* a real union */
+				}
+			}
+		}
+		else if (s.contains_key("properties"))
+			type = "object";
+		else if (s.contains_key("items"))
+			type = "array";
+
+		if (type == "boolean")
+			t.kind = gen_type::BOOL;
+		else if (type == "integer")
+			t.kind = gen_type::INT;
+		else if (type == "number")
+			t.kind = gen_type::NUM;
+		else if (type == "string")
+			t.kind = gen_type::STR;
+		else if (type == "array" && s.contains_key("items")) {
+			t.kind = gen_type::ARRAY;
+			t.item = std::make_shared<gen_type>();
+			if (!resolve(s["items"], hint + "_item", *t.item))
+				return false;
+		}
+		else if (type == "object" && s.contains_key("properties")) {
+			std::string name = hint;
+			if (s.contains_key("title") && s["title"].get_type() == lept_type::string)
+				name = make_ident(s["title"].get_string());
+			t.kind = gen_type::STRUCT;
+			t.name = name;
+			if (state[name]) {
+				error = state[name] == 1 ? "recursive reference to " + name : "duplicate struct " + name;
+				return false;
+			}
+			return build_struct(s, name);
+		}
+		else {
+			/* untyped, a union of types, or a container with no shape */
+			t.kind = gen_type::ANY;
+			t.nullable = false;
+		}
+		return true;
+	}
+
+	bool resolve_ref(const lept_value& ref, gen_type& t)
+	{
+		static const char* prefixes[] = { "#/$defs/", "#/definitions/" };
+		if (ref.get_type() == lept_type::string) {
+			const std::string& r = ref.get_string();
+			auto it = refs.find(r);
+			if (it != refs.end()) {
+				t = it->second;
+				return true;
+			}
+			for (const char* p : prefixes) {
+				size_t n = strlen(p);
+				std::string section(p + 2, n - 3);
+				if (r.compare(0, n, p) != 0 || !root->contains_key(section))
+					continue;
+				const lept_value& defs = (*root)[section];
+				std::string def = r.substr(n);
+				if (defs.get_type() != lept_type::object || !defs.contains_key(def))
+					break;
+				if (!resolve(defs[def], make_ident(def), t))
+					return false;
+				refs[r] = t;
+				return true;
+			}
+		}
+		error = "unsupported $ref";
+		return false;
+	}
+
+	bool build_struct(const lept_value& s, const std::string& name)
+	{
+		const lept_value& props = s["properties"];
+		if (props.get_type() != lept_type::object) {
+			error = name + ": properties must be an object";
+			return false;
+		}
+		state[name] = 1;
+		gen_struct st;
+		st.name = name;
+		for (auto& item : props.get_object()) {
+			gen_field f;
+			f.key = item.first;
+			f.ident = make_ident(item.first);
+			f.required = false;
+			if (!resolve(item.second, name + "_" + f.ident, f.type))
+				return false;
+			st.fields.push_back(std::move(f));
+		}
+		if (s.contains_key("required") && s["required"].get_type() == lept_type::array) {
+			const lept_value& req = s["required"];
+			for (size_t i = 0; i < req.get_array_size(); i++)
+				for (auto& f : st.fields)
+					if (req[(int)i].get_type() == lept_type::string && req[(int)i].get_string() == f.key)
+						f.required = true;
+		}
+		if (st.fields.size() > 64) {
+			error = name + ": more than 64 properties";
+			return false;
+		}
+		state[name] = 2;
+		structs.push_back(std::move(st));
+		return true;
+	}
+
+	static std::string base_type(const gen_type& t)
+	{
+		switch (t.kind) {
+			case gen_type::BOOL: return "bool";
+			case gen_type::INT: return "long long";
+			case gen_type::NUM: return "double";
+			case gen_type::STR: return "std::string";
+			case gen_type::ANY: return "lept_value";
+			case gen_type::ARRAY: return "std::vector<" + cpp_type(*t.item) + ">";
+			case gen_type::STRUCT: return t.name;
+		}
+		return "";
+	}
+
+	static std::string cpp_type(const gen_type& t)
+	{
+		return t.nullable ? "std::optional<" + base_type(t) + ">" : base_type(t);
+	}
+
+	static std::string field_type(const gen_field& f)
+	{
+		if (!f.required && !f.type.nullable)
+			return "std::optional<" + base_type(f.type) + ">";
+		return cpp_type(f.type);
+	}
+
+	static std::string check(const std::string& call)
+	{
+		return "if ((ret = " + call + ") != LEPT_PARSE_OK)\n";
+	}
+
+	/* Statements that read one value into expr and return on error. */
+	static void gen_read(std::string& out, const gen_type& t, const std::string& expr, int ind, int depth)
+	{
+		std::string in = tabs(ind);
+		if (t.nullable) {
+			std::string tv = "t" + std::to_string(depth);
+			out += in + "{\n";
+			out += in + "\tlept_type " + tv + ";\n";
+			out += in + "\t" + check("r.peek(" + tv + ")") + in + "\t\treturn ret;\n";
+			out += in + "\tif (" + tv + " == lept_type::null) {\n";
+			out += in + "\t\t" + check("r.read_null()") + in + "\t\t\treturn ret;\n";
+			out += in + "\t\t" + expr + ".reset();\n";
+			out += in + "\t}\n" + in + "\telse {\n";
+			gen_type inner = t;
+			inner.nullable = false;
+			gen_read_base(out, inner, expr + ".emplace()", ind + 2, depth + 1);
+			out += in + "\t}\n" + in + "}\n";
+		}
+		else
+			gen_read_base(out, t, expr, ind, depth);
+	}
+
+	static void gen_read_base(std::string& out, const gen_type& t, const std::string& expr, int ind, int depth)
+	{
+		std::string in = tabs(ind);
+		std::string call;
+		switch (t.kind) {
+			case gen_type::BOOL: call = "r.read_boolean(" + expr + ")"; break;
+			case gen_type::INT: call = "r.read_integer(" + expr + ")"; break;
+			case gen_type::NUM: call = "r.read_number(" + expr + ")"; break;
+			case gen_type::STR: call = "r.read_string(" + expr + ")"; break;
+			case gen_type::ANY: call = "r.read_value(" + expr + ")"; break;
+			case gen_type::STRUCT: call = "lept_gen_read(r, " + expr + ")"; break;
+			case gen_type::ARRAY:
+			{
+				std::string more = "more" + std::to_string(depth);
+				std::string a = "a" + std::to_string(depth);
+				out += in + "{\n";
+				out += in + "\tbool " + more + ";\n";
+				out += in + "\t" + check("r.begin_array()") + in + "\t\treturn ret;\n";
+				/* expr may be an emplace() call, so evaluate it once */
+				out += in + "\tauto& " + a + " = " + expr + ";\n";
+				out += in + "\t" + a + ".clear();\n";
+				out += in + "\twhile ((ret = r.next_element(" + more + ")) == LEPT_PARSE_OK && " + more + ")\n";
+				out += in + "\t{\n";
+				out += in + "\t\tauto& e" + std::to_string(depth) + " = " + a + ".emplace_back();\n";
+				gen_read(out, *t.item, "e" + std::to_string(depth), ind + 2, depth + 1);
+				out += in + "\t}\n";
+				out += in + "\tif (ret != LEPT_PARSE_OK)\n" + in + "\t\treturn ret;\n";
+				out += in + "}\n";
+				return;
+			}
+		}
+		out += in + check(call) + in + "\treturn ret;\n";
+	}
+
+	/* Statements that write expr. */
+	static void gen_write(std::string& out, const gen_type& t, const std::string& expr, int ind, int depth)
+	{
+		std::string in = tabs(ind);
+		if (t.nullable) {
+			gen_type inner = t;
+			inner.nullable = false;
+			out += in + "if (" + expr + ") {\n";
+			gen_write(out, inner, "(*" + expr + ")", ind + 1, depth);
+			out += in + "}\n" + in + "else\n" + in + "\tw.null();\n";
+			return;
+		}
+		switch (t.kind) {
+			case gen_type::BOOL: out += in + "w.boolean(" + expr + ");\n"; break;
+			case gen_type::INT: out += in + "w.integer(" + expr + ");\n"; break;
+			case gen_type::NUM: out += in + "w.number(" + expr + ");\n"; break;
+			case gen_type::STR: out += in + "w.string(" + expr + ");\n"; break;
+			case gen_type::ANY: out += in + "w.value(" + expr + ");\n"; break;
+			case gen_type::STRUCT: out += in + "lept_gen_write(w, " + expr + ");\n"; break;
+			case gen_type::ARRAY:
+			{
+				std::string i = "i" + std::to_string(depth);
+				out += in + "w.raw('[');\n";
+				out += in + "for (size_t " + i + " = 0; " + i + " < " + expr + ".size(); " + i + "++) {\n";
+				out += in + "\tif (" + i + ")\n" + in + "\t\tw.raw(',');\n";
+				gen_write(out, *t.item, expr + "[" + i + "]", ind + 1, depth + 1);
+				out += in + "}\n";
+				out += in + "w.raw(']');\n";
+				break;
+			}
+		}
+	}
+
+	static void emit_key(std::string& out, const gen_struct& s)
+	{
+		std::map<size_t, std::vector<size_t>> by_len;
+		for (size_t i = 0; i < s.fields.size(); i++)
+			by_len[s.fields[i].key.size()].push_back(i);
+		out += "inline size_t lept_gen_key(const " + s.name + "*, std::string_view key)\n{\n";
+		if (!by_len.empty()) {
+			out += "\tswitch (key.size()) {\n";
+			for (auto& len : by_len) {
+				out += "\t\tcase " + std::to_string(len.first) + ":\n";
+				for (size_t i : len.second)
+					out += "\t\t\tif (memcmp(key.data(), " + c_quote(s.fields[i].key) + ", " + std::to_string(len.first)
+						+ ") == 0)\n\t\t\t\treturn " + std::to_string(i) + ";\n";
+				out += "\t\t\tbreak;\n";
+			}
+			out += "\t}\n";
+		}
+		out += "\treturn " + std::to_string(s.fields.size()) + ";\n}\n\n";
+	}
+
+	static void emit_read(std::string& out, const gen_struct& s)
+	{
+		size_t n = s.fields.size();
+		unsigned long long required = 0;
+		for (size_t i = 0; i < n; i++)
+			if (s.fields[i].required)
+				required |= 1ull << i;
+
+		out += "inline int lept_gen_read(lept_reader& r, " + s.name + "& out)\n{\n";
+		if (n) {
+			out += "\tstatic const std::string_view keys[] = {";
+			for (size_t i = 0; i < n; i++)
+				out += std::string(i ? ", " : " ") + c_quote(s.fields[i].key);
+			out += " };\n";
+		}
+		out += "\tstd::string_view key;\n";
+		if (required)
+			out += "\tunsigned long long seen = 0;\n";
+		if (n)
+			out += "\tsize_t expect = 0;\n";
+		out += "\tbool more;\n\tint ret;\n";
+		out += "\t" + check("r.begin_object()") + "\t\treturn ret;\n";
+		out += "\twhile ((ret = r.next_key(key, more)) == LEPT_PARSE_OK && more) {\n";
+		if (n) {
+			/* the member after the previous one is the likely next key */
+			out += "\t\tsize_t i = expect < " + std::to_string(n) + " && key == keys[expect] ? expect : lept_gen_key(&out, key);\n";
+			out += "\t\tswitch (i) {\n";
+			for (size_t i = 0; i < n; i++) {
+				const gen_field& f = s.fields[i];
+				out += "\t\t\tcase " + std::to_string(i) + ":\n";
+				if (!f.required && !f.type.nullable)
+					gen_read_base(out, f.type, "out." + f.ident + ".emplace()", 4, 0);
+				else
+					gen_read(out, f.type, "out." + f.ident, 4, 0);
+				out += "\t\t\t\tbreak;\n";
+			}
+			out += "\t\t\tdefault:\n\t\t\t\t" + check("r.skip_value()") + "\t\t\t\t\treturn ret;\n\t\t\t\tcontinue;\n";
+			out += "\t\t}\n";
+			if (required)
+				out += "\t\tseen |= 1ull << i;\n";
+			out += "\t\texpect = i + 1;\n";
+		}
+		else
+			out += "\t\t" + check("r.skip_value()") + "\t\t\treturn ret;\n";
+		out += "\t}\n";
+		if (required) {
+			char mask[32];
+			snprintf(mask, sizeof(mask), "0x%llxull", required);
+			out += "\tif (ret == LEPT_PARSE_OK && (seen & " + std::string(mask) + ") != " + mask + ")\n";
+			out += "\t\tret = LEPT_PARSE_TYPE_MISMATCH;\n";
+		}
+		out += "\treturn ret;\n}\n\n";
+	}
+
+	static void emit_write(std::string& out, const gen_struct& s)
+	{
+		/* Whether a comma is needed is known statically until the first
+		 * omittable member; after that it is tracked in sep. */
+		enum { NONE, WRITTEN, RUNTIME } at = NONE;
+		bool declared = false;
+		out += "inline void lept_gen_write(lept_writer& w, const " + s.name + "& v)\n{\n";
+		out += "\tw.raw('{');\n";
+		for (size_t i = 0; i < s.fields.size(); i++) {
+			const gen_field& f = s.fields[i];
+			std::string key = json_quote(f.key) + ":";
+			std::string plain = "w.raw(" + c_quote(key) + ", " + std::to_string(key.size()) + ");\n";
+			std::string comma = "w.raw(" + c_quote("," + key) + ", " + std::to_string(key.size() + 1) + ");\n";
+			bool last = i + 1 == s.fields.size();
+			int ind = 1;
+			if (!f.required) {
+				if (at == NONE && !last && !declared) {
+					out += "\tbool sep = false;\n";
+					declared = true;
+				}
+				out += "\tif (v." + f.ident + ") {\n";
+				ind = 2;
+			}
+			std::string in = tabs(ind);
+			if (at == WRITTEN)
+				out += in + comma;
+			else if (at == NONE)
+				out += in + plain;
+			else
+				out += in + "if (sep)\n" + in + "\tw.raw(',');\n" + in + plain;
+			gen_type t = f.type;
+			std::string expr = "v." + f.ident;
+			if (!f.required) {
+				/* present here, so write the payload */
+				t.nullable = false;
+				expr = "(*v." + f.ident + ")";
+			}
+			gen_write(out, t, expr, ind, 0);
+			if (!f.required) {
+				if (at != WRITTEN && !last)
+					out += "\t\tsep = true;\n";
+				out += "\t}\n";
+				if (at == NONE)
+					at = RUNTIME;
+			}
+			else
+				at = WRITTEN;
+		}
+		out += "\tw.raw('}');\n}\n\n";
+	}
+};
+
+static bool read_file(const char* path, std::string& out)
+{
+	FILE* fp = fopen(path, "rb");
+	if (!fp)
+		return false;
+	char buf[65536];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+		out.append(buf, n);
+	fclose(fp);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3 || argc > 4) {
+		fprintf(stderr, "usage: %s schema.json out.h [RootName]\n", argv[0]);
+		return 2;
+	}
+	std::string text;
+	if (!read_file(argv[1], text)) {
+		fprintf(stderr, "%s: cannot read\n", argv[1]);
+		return 1;
+	}
+	lept_value schema;
+	int ret = schema.parse(text);
+	if (ret != LEPT_PARSE_OK) {
+		fprintf(stderr, "%s: parse error %d\n", argv[1], ret);
+		return 1;
+	}
+	std::string name = "root";
+	if (argc == 4)
+		name = make_ident(argv[3]);
+	lept_codegen gen;
+	if (!gen.load(schema, name)) {
+		fprintf(stderr, "%s: %s\n", argv[1], gen.error.c_str());
+		return 1;
+	}
+	const char* base = strrchr(argv[1], '/');
+	std::string code = gen.emit(base ? base + 1 : argv[1]);
+	FILE* fp = fopen(argv[2], "wb");
+	if (!fp || fwrite(code.data(), 1, code.size(), fp) != code.size()) {
+		fprintf(stderr, "%s: cannot write\n", argv[2]);
+		if (fp)
+			fclose(fp);
+		return 1;
+	}
+	return fclose(fp) == 0 ? 0 : 1;
+}
@@ -1,6 +1,10 @@
 #include "leptjson.h"
+#include "leptjson_utf8.h"
+#include "leptjson_reader.h"
+#include "leptjson_scan.h"
 #include <assert.h>
 #include <math.h>
+#include <stdint.h>
 #include <string>
 #include <utility>
 #include <vector>
@@ -8,46 +12,101 @@
 #include <iostream>
 #include "double-conversion.h"
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#ifdef LEPT_HAVE_WRITEV
+#include <limits.h>
+#include <sys/uio.h>
+#endif
+#ifdef LEPT_PARSE_STATS
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
 using namespace double_conversion;
 
-#define ISDIGIT(ch) ((ch) >= '0' && (ch) <= '9')
-#define ISDIGIT1TO9(ch) ((ch) >= '1' && (ch) <= '9')
+
+#ifdef LEPT_PARSE_STATS
+static inline unsigned long long lept_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+class lept_stat_timer {
+public:
+	lept_stat_timer(lept_parse_stats* s, int phase) : stats(s), phase(phase) {
+		if (stats) start = lept_cycles();
+	}
+	~lept_stat_timer() {
+		if (stats) stats->cycles[phase] += lept_cycles() - start;
+	}
+private:
+	lept_parse_stats* stats;
+	int phase;
+	unsigned long long start;
+};
+
+class lept_stat_depth {
+public:
+	lept_stat_depth(lept_parse_stats* s, size_t& d) : stats(s), depth(d) {
+		if (stats && ++depth > stats->max_depth) stats->max_depth = depth;
+	}
+	~lept_stat_depth() {
+		if (stats) --depth;
+	}
+private:
+	lept_parse_stats* stats;
+	size_t& depth;
+};
+
+#define LEPT_STAT(stmt) do { if (stats) { stmt; } } while (0)
+#define LEPT_STAT_TIMER(phase) lept_stat_timer stat_timer_(stats, phase)
+#define LEPT_STAT_DEPTH() lept_stat_depth stat_depth_(stats, depth)
+#else
+#define LEPT_STAT(stmt) do { } while (0)
+#define LEPT_STAT_TIMER(phase) do { } while (0)
+#define LEPT_STAT_DEPTH() do { } while (0)
+#endif
 
 class lept_context{
 public :
-	std::string json;
+	std::string_view json;		/* the input, including its terminating '\0' */
 	size_t ptr;
 
-	size_t  str_top;
-	std::string stk_str;
+	std::string stk_str;		/* the string being unescaped */
+	bool borrow;				/* strings may point into json */
+	char* insitu;				/* json, writable: unescape strings in place */
+	const lept_field_mask* mask;	/* what to build below here; nullptr for all */
+
+	lept_parse_stats* stats;
+	size_t depth;
+	int nesting;				/* containers open around the value being parsed */
+	unsigned flags;
+
+	int parse(lept_value* v);
 
 	void parse_whitespace();
 	int parse_value(lept_value* v);
 	int parse_literal(lept_value* v, std::string literal , lept_type type);
 	int parse_number(lept_value* v);
 	int parse_string(lept_value* v);
-	size_t parse_hex4(size_t p , int* u);
 	int parse_array(lept_value* v);
 	int parse_object(lept_value* v);
-	void encode_utf8(int u);
-	void push_char(char c);
-	std::string pop_string(size_t size);
+	int skip_value();
 
-	lept_context() { ptr = str_top = 0; stk_str = ""; };
+	lept_context() { ptr = depth = 0; nesting = 0; stk_str = ""; stats = nullptr; flags = 0; borrow = false; insitu = nullptr; mask = nullptr; };
 };
 
 
-void lept_context::push_char(char c) {
-	str_top++;
-	stk_str.push_back(c);
-}
-
-std::string lept_context::pop_string(size_t size) {
-	assert(str_top >= size);
-	return stk_str;
-}
-
 void lept_context::parse_whitespace() {
+	LEPT_STAT_TIMER(LEPT_PHASE_WHITESPACE);
 	size_t tmp = this->ptr;
 	while (json[tmp] == ' ' || json[tmp] == '\t' || json[tmp] == '\n' || json[tmp] == '\r')
 		tmp++;
@@ -57,6 +116,7 @@ void lept_context::parse_whitespace() {
 
 int lept_context::parse_literal(lept_value* v, std::string literal, lept_type type) {
 	assert(ptr < json.size() && json[ptr] == literal[0]);
+	LEPT_STAT_TIMER(LEPT_PHASE_LITERAL);
 	int i;
 	for (i = 0; i < literal.size(); i++) {
 		if (json[i + ptr] != literal[i])
@@ -70,158 +130,107 @@ int lept_context::parse_literal(lept_value* v, std::string literal, lept_type ty
 	return LEPT_PARSE_OK;
 }
 
-
 int lept_context::parse_number(lept_value* v) {
-	size_t tmp = ptr;
-	bool is_integer = true;
-
-	if (json[tmp] == '-') tmp++;
-	if (json[tmp] == '0') tmp++;
-	else {
-		if (!ISDIGIT1TO9(json[tmp])) return LEPT_PARSE_INVALID_VALUE;
-		for (tmp++; ISDIGIT(json[tmp]); tmp++);
-	}
-	if (json[tmp] == '.') {
-		is_integer = false;
-		tmp++;
-		if (!ISDIGIT(json[tmp])) return LEPT_PARSE_INVALID_VALUE;
-		for (tmp++; ISDIGIT(json[tmp]); tmp++);
-	}
-	if (json[tmp] == 'e' || json[tmp] == 'E') {
-		is_integer = false;
-		tmp++;
-		if (json[tmp] == '+' || json[tmp] == '-') tmp++;
-		if (!ISDIGIT(json[tmp])) return LEPT_PARSE_INVALID_VALUE;
-		for (tmp++; ISDIGIT(json[tmp]); tmp++);
-	}
-
-	if (is_integer)
-	{
-		try {
-			long long int_val = std::stoll(json.substr(ptr, tmp - ptr));
-			v->set_integer(int_val);
-		}
-		catch (const std::out_of_range& e) {
-			return LEPT_PARSE_NUMBER_TOO_BIG;
-		}
-	} else
-	{
-		const int flags = StringToDoubleConverter::ALLOW_TRAILING_JUNK |
-							   StringToDoubleConverter::ALLOW_LEADING_SPACES;
-		StringToDoubleConverter converter(flags, 0.0, 0.0, "inf", "nan");
-		int processed_characters_count;
-		double num = converter.StringToDouble(json.substr(ptr, tmp - ptr).c_str() , tmp - ptr, &processed_characters_count);
-
-		/*if (errno == ERANGE && (num == HUGE_VAL || num == -HUGE_VAL))
-			return LEPT_PARSE_NUMBER_TOO_BIG;*/
-		if (std::isinf(num) || std::isnan(num))
-			return LEPT_PARSE_NUMBER_TOO_BIG;
-		v->set_number(num);
-		//double num = stod(json.substr(ptr, tmp - ptr));
+	LEPT_STAT_TIMER(LEPT_PHASE_NUMBER);
+	const char* p = json.data() + ptr;
+	const char* stop;
+	bool is_integer;
+	int ret;
+	if ((ret = lept_scan_number(p, json.data() + json.size() - 1, stop, is_integer)) != LEPT_PARSE_OK)
+		return ret;
+	if (lept_number_too_big(p, stop, is_integer))
+		return LEPT_PARSE_NUMBER_TOO_BIG;
+	size_t len = (size_t)(stop - p);
+
+	/* An integer of more than nine digits may not fit an int, so it is kept
+	 * as a number, as it would be if converted now. */
+	if (flags & LEPT_PARSE_LAZY_NUMBERS) {
+		bool small = is_integer && len - (*p == '-') <= 9;
+		v->set_raw_number(small ? lept_type::integer : lept_type::number, p, len);
+		ptr += len;
+		return LEPT_PARSE_OK;
 	}
 
-	ptr = tmp;
+	lept_set_number(*v, p, stop, is_integer);
+	LEPT_STAT(is_integer ? stats->number_fast++ : stats->number_slow++);
+	ptr += len;
 	return LEPT_PARSE_OK;
 }
 
-size_t lept_context::parse_hex4(size_t p, int* u) {
-	*u = 0;
-	for (int i = 0; i < 4; i++) {
-		char ch = json[++ p];
-		*u <<= 4;
-		if (ch >= '0' && ch <= '9') *u |= ch - '0';
-		else if (ch >= 'A' && ch <= 'Z') *u |= ch - ('A' - 10);
-		else if (ch >= 'a' && ch <= 'z') *u |= ch - ('a' - 10);
-		else return 0;
-	}
-	return p;
-}
-
-void lept_context::encode_utf8(int u) {
-	if (u <= 0x7F)
-		push_char((char)u);
-	else if (u <= 0x7FF) {
-		push_char((char)(0xC0 | ((u >> 6) & 0xFF)));
-		push_char((char)(0x80 | (u) & 0x3F));
-	}
-	else if (u <= 0xFFFF) {
-		push_char((char)(0xE0 | (u >> 12) & 0xFF));
-		push_char((char)(0x80 | (u >> 6) & 0x3F));
-		push_char((char)(0x80 | u & 0x3F));
-	}
-	else {
-		assert(u <= 0x10FFFF);
-		push_char((char)(0xF0 | (u >> 18) & 0xFF));
-		push_char((char)(0x80 | (u >> 12) & 0x3F));
-		push_char((char)(0x80 | (u >> 6) & 0x3F));
-		push_char((char)(0x80 | u & 0x3F));
-	}
-}
-
 int lept_context::parse_string(lept_value* v) {
 	assert(ptr < json.size() && json[ptr] == '\"');
-	size_t tmp = ptr, len = 0, head = str_top;
-	std::string str;
-	int u, u2;
+	LEPT_STAT_TIMER(LEPT_PHASE_STRING);
+	/* Plain characters are left in json while scanning; [run, tmp) goes to
+	 * stk_str only when an escape or the closing quote is reached, so a
+	 * string without escapes is copied once or, if borrowing, not at all. */
+	size_t tmp = ptr, run = ptr + 1;
+	stk_str.clear();
 	for (;;) {
 		char ch = json[++tmp];
 		switch (ch) {
 			case '\"':
-				len = str_top - head;
-				v->set_string(pop_string(len));
+				if (stk_str.empty()) {
+					LEPT_STAT(stats->string_bytes += tmp - run);
+					if (borrow)
+						v->set_borrowed(json.data() + run, tmp - run);
+					else
+						v->set_string(std::string(json.substr(run, tmp - run)));
+				}
+				else {
+					stk_str.append(json, run, tmp - run);
+					LEPT_STAT(stats->string_bytes += stk_str.size());
+					if (insitu) {
+						/* unescaping only shrinks, so it fits where it came from */
+						memcpy(insitu + ptr + 1, stk_str.data(), stk_str.size());
+						v->set_borrowed(insitu + ptr + 1, stk_str.size());
+					}
+					else
+						v->set_string(stk_str);
+				}
 				ptr = ++tmp;
-				str_top = head;
-				stk_str.clear();
 				return LEPT_PARSE_OK;
 			case '\\':
-				switch (json[++tmp]) {
-					case '\"': push_char('\"');  break;
-					case '\\': push_char('\\'); break;
-					case '/': push_char('/');  break;
-					case 'b': push_char('\b'); break;
-					case 't': push_char('\t'); break;
-					case 'n': push_char('\n'); break;
-					case 'r':push_char('\r'); break;
-					case 'f': push_char('\f'); break;
-					case 'u':
-						if (!(tmp = parse_hex4(tmp, &u)))
-							return LEPT_PARSE_INVALID_UNICODE_HEX;
-						if (u >= 0xD800 && u <= 0xDBFF) {
-							if (json[++tmp] != '\\')
-								return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
-							if (json[++tmp] != 'u')
-								return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
-							if (!(tmp = parse_hex4(tmp, &u2)))
-								return LEPT_PARSE_INVALID_UNICODE_HEX;
-							if (u2 < 0xDC00 || u2 > 0xDFFF)
-								return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
-							u = (((u - 0xD800) << 10) | (u2 - 0xDC00)) + 0x10000;
-						}
-						encode_utf8(u);
-						break;
-					default:
-						return LEPT_PARSE_INVALID_STRING_CHAR;
-				}
+			{
+				LEPT_STAT(stats->escapes++);
+				stk_str.append(json, run, tmp - run);
+				const char* q = json.data() + tmp + 1;
+				int ret = lept_unescape(q, json.data() + json.size() - 1, &stk_str, flags);
+				if (ret != LEPT_PARSE_OK)
+					return ret;
+				tmp = (size_t)(q - json.data()) - 1;
+				run = tmp + 1;
+			}
 				break;
 			case '\0':
-				str_top = 0;
-				stk_str.clear();
 				return LEPT_PARSE_MISS_QUOTATION_MARK;
 			default:
-				if ((unsigned char)ch < 0x20) {
-					str_top = 0;
-					stk_str.clear();
+				if ((unsigned char)ch < 0x20)
 					return LEPT_PARSE_INVALID_STRING_CHAR;
+				{
+					/* skip the whole run of plain characters at once; a run
+					 * ends only at ASCII, so no UTF-8 sequence spans two and
+					 * strict mode checks each while it is still in cache */
+					size_t end = tmp + 1;
+					unsigned char c, high = (unsigned char)ch;
+					while ((c = (unsigned char)json[end]) >= 0x20 && c != '\"' && c != '\\') {
+						high |= c;
+						end++;
+					}
+					if ((flags & LEPT_PARSE_STRICT_UTF8) && (high & 0x80) &&
+						!lept_validate_utf8(json.data() + tmp, end - tmp))
+						return LEPT_PARSE_INVALID_UTF8;
+					tmp = end - 1;
 				}
-				push_char(ch);
 				break;
 		}
 	}
 }
 
 int lept_context::parse_array(lept_value* v) {
-	assert(json[ptr ++] == '[');
-	std::vector<lept_value> arr;
+	assert(json[ptr] == '[');
+	ptr++;
+	LEPT_STAT_DEPTH();
+	lept_value::array_t arr;
 	parse_whitespace();
 	if (json[ptr] == ']') {
 		ptr++;
@@ -234,7 +243,7 @@ int lept_context::parse_array(lept_value* v) {
 		lept_value e;
 		if ((ret = parse_value(&e)) != LEPT_PARSE_OK)
 			break;
-		arr.push_back(e);
+		arr.push_back(std::move(e));
 		len++;
 		parse_whitespace();
 		if (json[ptr] == ',') {
@@ -254,9 +263,20 @@ int lept_context::parse_array(lept_value* v) {
 	return ret;
 }
 
+/* Steps over a value with the reader's checked skip: what is not built is
+ * still held to the grammar parse() applies. */
+int lept_context::skip_value() {
+	lept_reader r(json.substr(ptr, json.size() - 1 - ptr));
+	int ret = r.skip_value(nesting);
+	ptr += r.offset();
+	return ret;
+}
+
 int lept_context::parse_object(lept_value* v) {
-	assert(json[ptr ++] == '{');
-	std::map<std::string, lept_value> mp;
+	assert(json[ptr] == '{');
+	ptr++;
+	LEPT_STAT_DEPTH();
+	lept_value::object_t mp;
 	parse_whitespace();
 	if (json[ptr] == '}') {
 		v->set_object(std::move(mp));
@@ -267,8 +287,14 @@ int lept_context::parse_object(lept_value* v) {
 	for (;;) {
 		if (json[ptr] != '\"')
 			return LEPT_PARSE_MISS_KEY;
+		/* a key without escapes is looked at in place, and copied only
+		 * when it is kept */
 		lept_value str;
-		if ((ret = parse_string(&str)) != LEPT_PARSE_OK)
+		bool saved = borrow;
+		borrow = true;
+		ret = parse_string(&str);
+		borrow = saved;
+		if (ret != LEPT_PARSE_OK)
 			return ret;
 		parse_whitespace();
 		if (json[ptr] != ':')
@@ -277,10 +303,21 @@ int lept_context::parse_object(lept_value* v) {
 			ptr++;
 			parse_whitespace();
 		}
-		lept_value e;
-		if ((ret = parse_value(&e)) != LEPT_PARSE_OK)
-			return ret;
-		mp.insert(std::pair<std::string, lept_value>(str.get_string(), e));
+		const lept_field_mask* outer = mask;
+		const lept_field_mask* inner = outer ? outer->find(str.get_string_view()) : nullptr;
+		if (outer && !inner) {
+			if ((ret = skip_value()) != LEPT_PARSE_OK)
+				return ret;
+		}
+		else {
+			lept_value e;
+			mask = inner && !inner->all() ? inner : nullptr;
+			ret = parse_value(&e);
+			mask = outer;
+			if (ret != LEPT_PARSE_OK)
+				return ret;
+			mp.emplace(str.lazy ? std::string(str.v.view.text) : std::move(str.v.s), std::move(e));
+		}
 		parse_whitespace();
 		if (json[ptr] == '}') {
 			v->set_object(std::move(mp));
@@ -298,20 +335,96 @@ int lept_context::parse_object(lept_value* v) {
 }
 
 int lept_context::parse_value(lept_value* v) {
+	int ret;
 	switch (this->json[ptr]) {
-		case 't': return this->parse_literal(v, "true", lept_type::boolean);
-		case 'f': return this->parse_literal(v, "false", lept_type::boolean);
-		case 'n': return this->parse_literal(v, "null", lept_type::null);
+		case 't': ret = this->parse_literal(v, "true", lept_type::boolean); break;
+		case 'f': ret = this->parse_literal(v, "false", lept_type::boolean); break;
+		case 'n': ret = this->parse_literal(v, "null", lept_type::null); break;
 		case '\0': return LEPT_PARSE_EXPECT_VALUE;
-		case '\"': return this->parse_string(v);
-		case '[': return this->parse_array(v);
-		case '{': return this->parse_object(v);
-		default: return parse_number(v);
+		case '\"': ret = this->parse_string(v); break;
+		case '[':
+		case '{':
+			if (nesting == LEPT_PARSE_MAX_DEPTH)
+				return LEPT_PARSE_TOO_DEEP;
+			nesting++;
+			ret = json[ptr] == '[' ? parse_array(v) : parse_object(v);
+			nesting--;
+			break;
+		default: ret = parse_number(v); break;
 	}
+	LEPT_STAT(if (ret == LEPT_PARSE_OK) stats->nodes[(int)v->get_type()]++);
+	return ret;
+}
+
+int lept_context::parse(lept_value* v) {
+	int ret;
+	LEPT_STAT_TIMER(LEPT_PHASE_TOTAL);
+	parse_whitespace();
+	ret = parse_value(v);
+	if (ret == LEPT_PARSE_OK) {
+		parse_whitespace();
+		if (ptr != json.size() - 1) {
+			v->set_null();
+			ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+		}
+	}
+	LEPT_STAT(stats->bytes = ptr);
+	stk_str.clear();
+	return ret;
+}
+
+/**********************************  lept_field_mask  **************************************/
+
+lept_field_mask::lept_field_mask(std::initializer_list<std::string_view> paths) : keep_all(false) {
+	for (auto path : paths)
+		add(path);
+}
+
+lept_field_mask& lept_field_mask::member(std::string_view key) {
+	auto it = std::lower_bound(members.begin(), members.end(), key,
+		[](const std::pair<std::string, lept_field_mask>& m, std::string_view k) { return m.first < k; });
+	if (it == members.end() || it->first != key)
+		it = members.emplace(it, std::string(key), lept_field_mask());
+	return it->second;
+}
+
+void lept_field_mask::add(std::string_view dotted) {
+	std::vector<std::string> path;
+	size_t start = 0, dot;
+	while ((dot = dotted.find('.', start)) != std::string_view::npos) {
+		path.emplace_back(dotted.substr(start, dot - start));
+		start = dot + 1;
+	}
+	path.emplace_back(dotted.substr(start));
+	add(path);
+}
+
+void lept_field_mask::add(const std::vector<std::string>& path) {
+	lept_field_mask* m = this;
+	for (auto& key : path) {
+		if (m->keep_all)
+			return;
+		m = &m->member(key);
+	}
+	m->keep_all = true;
+	m->members.clear();
+}
+
+const lept_field_mask* lept_field_mask::find(std::string_view key) const {
+	if (keep_all)
+		return this;
+	auto it = std::lower_bound(members.begin(), members.end(), key,
+		[](const std::pair<std::string, lept_field_mask>& m, std::string_view k) { return m.first < k; });
+	return it != members.end() && it->first == key ? &it->second : nullptr;
 }
 
 /**********************************  lept_value  **************************************/
 
+template<typename T, typename... Args>
+static std::shared_ptr<T> lept_make_shared(Args&&... args) {
+	return std::allocate_shared<T>(lept_container_allocator<T>(), std::forward<Args>(args)...);
+}
+
 std::string lept_value::typeStr(lept_type t)
 {
 #define CASE_(x, s) case lept_type::x: return #s;
@@ -330,22 +443,61 @@ std::string lept_value::typeStr(lept_type t)
 
 int lept_value::parse(std::string json) {
 	lept_context c;
-	int ret;
-	c.json = json + '\0';
-	c.str_top = 0;
+	json.push_back('\0');
+	c.json = json;
 	this->free();
-	c.parse_whitespace();
-	ret = c.parse_value(this);
-	if (ret) {
-		c.parse_whitespace();
-		if (c.ptr != c.json.size() - 1) {
-			this->type = lept_type::null;
-			ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
-		}
-	}
-	assert(c.str_top == 0);
-	c.stk_str.clear();
-	return ret;
+	return c.parse(this);
+}
+
+int lept_value::parse(std::string json, unsigned flags) {
+	lept_context c;
+	c.flags = flags;
+	json.push_back('\0');
+	c.json = json;
+	this->free();
+	return c.parse(this);
+}
+
+int lept_value::parse(std::string json, const lept_field_mask& mask, unsigned flags) {
+	lept_context c;
+	c.flags = flags;
+	c.mask = mask.all() ? nullptr : &mask;
+	json.push_back('\0');
+	c.json = json;
+	this->free();
+	return c.parse(this);
+}
+
+int lept_value::parse_borrowed(const char* json, unsigned flags) {
+	lept_context c;
+	c.flags = flags;
+	c.borrow = true;
+	c.json = std::string_view(json, strlen(json) + 1);
+	this->free();
+	return c.parse(this);
+}
+
+int lept_value::parse_insitu(char* json, unsigned flags) {
+	lept_context c;
+	c.flags = flags;
+	c.borrow = true;
+	c.insitu = json;
+	c.json = std::string_view(json, strlen(json) + 1);
+	this->free();
+	return c.parse(this);
+}
+
+int lept_value::parse(std::string json, lept_parse_stats& stats) {
+	lept_context c;
+	memset(&stats, 0, sizeof(stats));
+#ifdef LEPT_PARSE_STATS
+	stats.enabled = true;
+	c.stats = &stats;
+#endif
+	json.push_back('\0');
+	c.json = json;
+	this->free();
+	return c.parse(this);
 }
 
 lept_value::lept_value() noexcept{
@@ -353,32 +505,55 @@ lept_value::lept_value() noexcept{
 }
 
 lept_value::lept_value(const lept_value& val) {
-	switch (val.type) {
+	if (val.lazy)
+		copy_lazy(val);
+	else switch (val.type) {
 		case lept_type::number: v.n = val.v.n; break;
 		case lept_type::integer: v.i = val.v.i; break;
 		case lept_type::boolean: v.b = val.v.b; break;
 		case lept_type::string: new(&v.s) std::string(val.v.s); break;
-		case lept_type::array: new(&v.arr) array_t(val.v.arr); break;
-		case lept_type::object: new(&v.obj) object_t(val.v.obj); break;
+		case lept_type::array: new(&v.arr) shared_array(lept_make_shared<array_t>(*val.v.arr)); break;
+		case lept_type::object: new(&v.obj) shared_object(lept_make_shared<object_t>(*val.v.obj)); break;
 		default: break;
 	}
 	type = val.type;
+	lazy = val.lazy;
+}
+
+lept_value::lept_value(lept_value&& val) noexcept {
+	if (val.lazy)
+		copy_lazy(val);
+	else switch (val.type) {
+		case lept_type::number: v.n = val.v.n; break;
+		case lept_type::integer: v.i = val.v.i; break;
+		case lept_type::boolean: v.b = val.v.b; break;
+		case lept_type::string: new(&v.s) std::string(std::move(val.v.s)); break;
+		case lept_type::array: new(&v.arr) shared_array(std::move(val.v.arr)); break;
+		case lept_type::object: new(&v.obj) shared_object(std::move(val.v.obj)); break;
+		default: break;
+	}
+	type = val.type;
+	lazy = val.lazy;
+	val.free();
 }
 
 lept_value& lept_value::operator=(lept_value val) {
 	this->free();
 
-	switch (val.type) {
+	if (val.lazy)
+		copy_lazy(val);
+	else switch (val.type) {
 		case lept_type::number: v.n = val.v.n; break;
 		case lept_type::integer: v.i = val.v.i; break;
 		case lept_type::boolean: v.b = val.v.b; break;
 		case lept_type::string: new(&v.s) std::string(std::move(val.v.s)); break;
-		case lept_type::array: new(&v.arr) array_t(std::move(val.v.arr)); break;
-		case lept_type::object: new(&v.obj) object_t(std::move(val.v.obj)); break;
+		case lept_type::array: new(&v.arr) shared_array(std::move(val.v.arr)); break;
+		case lept_type::object: new(&v.obj) shared_object(std::move(val.v.obj)); break;
 		default: break;
 	}
 
 	type = val.type;
+	lazy = val.lazy;
 	return *this;
 }
 
@@ -387,17 +562,74 @@ lept_value::~lept_value() noexcept{
 }
 
 void lept_value::free() {
-	switch (this->type) {
+	if (lazy && type == lept_type::string)
+		delete v.view.copy.load(std::memory_order_acquire);
+	else if (lazy && v.raw.len > sizeof(v.raw.small))
+		delete[] v.raw.heap;
+	else if (!lazy) switch (this->type) {
 		case lept_type::string:
 			v.s.~basic_string(); break;
 		case lept_type::array:
-			v.arr.~vector(); break;
+			v.arr.~shared_array(); break;
 		case lept_type::object :
-			v.obj.~map(); break;
+			v.obj.~shared_object(); break;
 		default:
 			break;
 	}
 	type = lept_type::null;
+	lazy = false;
+}
+
+void lept_value::set_raw_number(lept_type t, const char* s, size_t len) {
+	this->free();
+	new(&v.raw) raw_t;
+	v.raw.value.store(NAN, std::memory_order_relaxed);
+	v.raw.len = len;
+	if (len > sizeof(v.raw.small))
+		v.raw.heap = new char[len];
+	memcpy((char*)v.raw.text(), s, len);
+	type = t;
+	lazy = true;
+}
+
+void lept_value::set_borrowed(const char* s, size_t len) {
+	this->free();
+	type = lept_type::string;
+	lazy = true;
+	new(&v.view) borrowed_t(std::string_view(s, len));
+}
+
+void lept_value::copy_lazy(const lept_value& val) {
+	if (val.type == lept_type::string)
+		new(&v.view) borrowed_t(val.v.view.text);
+	else {
+		new(&v.raw) raw_t;
+		v.raw.value.store(val.v.raw.value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		v.raw.len = val.v.raw.len;
+		if (v.raw.len > sizeof(v.raw.small))
+			v.raw.heap = new char[v.raw.len];
+		memcpy((char*)v.raw.text(), val.v.raw.text(), v.raw.len);
+	}
+}
+
+double lept_value::raw_value() const {
+	double d = v.raw.value.load(std::memory_order_relaxed);
+	if (std::isnan(d)) {
+		d = lept_strtod(v.raw.text(), v.raw.len);
+		v.raw.value.store(d, std::memory_order_relaxed);
+	}
+	return d;
+}
+
+void lept_value::resolve() {
+	if (!lazy)
+		return;
+	if (type == lept_type::integer)
+		set_integer(get_integer());
+	else if (type == lept_type::number)
+		set_number(get_number());
+	else
+		set_string(std::string(v.view.text));
 }
 
 void lept_value::set_null() {
@@ -423,6 +655,8 @@ void lept_value::set_number(double num) {
 
 double lept_value::get_number() const{
 	assert(this->type == lept_type::number);
+	if (lazy)
+		return raw_value();
 	return v.n;
 }
 
@@ -436,12 +670,30 @@ void lept_value::set_integer(int i)
 int lept_value::get_integer() const
 {
 	assert(this->type == lept_type::integer);
+	if (lazy)
+		return (int)raw_value();
 	return v.i;
 }
 
 const std::string& lept_value::get_string() const {
 	assert(type == lept_type::string);
-	return v.s;
+	if (!lazy)
+		return v.s;
+	std::string* s = v.view.copy.load(std::memory_order_acquire);
+	if (!s) {
+		/* racing readers each make a copy and keep whichever came first */
+		std::string* fresh = new std::string(v.view.text);
+		if (v.view.copy.compare_exchange_strong(s, fresh, std::memory_order_acq_rel, std::memory_order_acquire))
+			s = fresh;
+		else
+			delete fresh;
+	}
+	return *s;
+}
+
+std::string_view lept_value::get_string_view() const {
+	assert(type == lept_type::string);
+	return lazy ? v.view.text : std::string_view(v.s);
 }
 
 void lept_value::set_string(std::string str) {
@@ -450,90 +702,121 @@ void lept_value::set_string(std::string str) {
 	type = lept_type::string;
 }
 
-void lept_value::set_array(std::vector<lept_value>&& val) {
+void lept_value::set_array(array_t&& val) {
 	this->free();
 	type = lept_type::array;
-	new(&v.arr) std::vector<lept_value>(std::move(val));
+	new(&v.arr) shared_array(lept_make_shared<array_t>(std::move(val)));
 }
 
 void lept_value::set_array(const array_t& arr) {
 	this->free();
 	type = lept_type::array;
-	new(&v.arr) std::vector<lept_value>(arr);
+	new(&v.arr) shared_array(lept_make_shared<array_t>(arr));
 }
 
 size_t lept_value::get_array_size() const {
 	assert(type == lept_type::array);
-	return v.arr.size();
+	return v.arr->size();
 }
 
 lept_value& lept_value::get_array_element(size_t index) {
-	assert(type == lept_type::array && v.arr.size() > index);
-	return v.arr[index];
+	assert(type == lept_type::array && v.arr->size() > index);
+	return own_array()[index];
 }
 
 const lept_value& lept_value::get_array_element(size_t index) const {
-	assert(type == lept_type::array && v.arr.size() > index);
-	return v.arr[index];
+	assert(type == lept_type::array && v.arr->size() > index);
+	return (*v.arr)[index];
 }
 
 bool lept_value::contains_key(std::string key) const {
 	assert(type == lept_type::object);
-	return (v.obj.count(key) != 0);
+	return (v.obj->count(key) != 0);
 }
 
 lept_value lept_value::get_object_value(std::string key) {
-	assert(v.obj.count(key) > 0);
-	return v.obj[key];
+	assert(v.obj->count(key) > 0);
+	return v.obj->at(key);
 }
 
 size_t lept_value::get_object_size() const {
 	assert(type == lept_type::object);
-	return v.obj.size();
+	return v.obj->size();
+}
+
+/* Whether p is the only holder of its container.  use_count() is a relaxed
+ * load; the fence makes the reads other holders did before letting go
+ * happen before our writes, as the release in their decrement allows. */
+template<typename T>
+static bool sole_owner(const std::shared_ptr<T>& p) {
+	if (p.use_count() != 1)
+		return false;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return true;
+}
+
+lept_value lept_value::share() const {
+	lept_value val;
+	if (lazy || (type != lept_type::array && type != lept_type::object))
+		return *this;
+	if (type == lept_type::array)
+		new(&val.v.arr) shared_array(v.arr);
+	else
+		new(&val.v.obj) shared_object(v.obj);
+	val.type = type;
+	return val;
+}
+
+/* A shared container is cloned one level deep; the children are shared in
+ * turn and cloned only when a write reaches them. */
+lept_value::array_t& lept_value::own_array() {
+	if (!sole_owner(v.arr)) {
+		shared_array arr = lept_make_shared<array_t>();
+		arr->reserve(v.arr->size());
+		for (auto& e : *v.arr)
+			arr->push_back(e.share());
+		v.arr = std::move(arr);
+	}
+	return *v.arr;
+}
+
+lept_value::object_t& lept_value::own_object() {
+	if (!sole_owner(v.obj)) {
+		shared_object obj = lept_make_shared<object_t>();
+		for (auto& item : *v.obj)
+			obj->emplace_hint(obj->end(), item.first, item.second.share());
+		v.obj = std::move(obj);
+	}
+	return *v.obj;
 }
 
 void lept_value::set_object(object_t&& mp) {
 	this->free();
 	type = lept_type::object;
-	new(&v.obj) std::map<std::string, lept_value>(std::move(mp));
+	new(&v.obj) shared_object(lept_make_shared<object_t>(std::move(mp)));
 }
 
-void lept_value::set_object(const std::map<std::string, lept_value>& mp) {
+void lept_value::set_object(const object_t& mp) {
 	this->free();
 	type = lept_type::object;
 	// mp 是一个左值引用，这里只能调用拷贝构造函数
-	new(&v.obj) std::map<std::string, lept_value>(mp);
+	new(&v.obj) shared_object(lept_make_shared<object_t>(mp));
 }
 
-void lept_value::stringify_string(std::string& stk) const {
-	stk += '\"';
-	for (int i = 0; i < v.s.size(); i++) {
-		char ch = v.s[i];
-		switch (ch) {
-			case '\"': stk += "\\\""; break;
-			case '/': stk += "\\/"; break;
-			case '\\': stk += "\\\\"; break;
-			case '\b': stk += "\\b"; break;
-			case '\t': stk += "\\t"; break;
-			case '\r': stk += "\\r"; break;
-			case '\f': stk += "\\f"; break;
-			case '\n': stk += "\\n"; break;
-			default:
-				if (ch < 0x20) {
-					char buff[7];
-					snprintf(buff, sizeof(buff), "\\u%04X", ch);
-					stk += buff;
-				}
-				else
-					stk += v.s[i];
-				break;
-		}
-	}
-	stk += '\"';
+static void stringify_escaped(std::string& stk, std::string_view str, unsigned flags) {
+	lept_escape_string(str, flags, [&stk](const char* p, size_t n) { stk.append(p, n); });
 }
 
-void lept_value::stringify_value(std::string& stk) const {
+void lept_value::stringify_string(std::string& stk, unsigned flags) const {
+	stringify_escaped(stk, get_string_view(), flags);
+}
+
+void lept_value::stringify_value(std::string& stk, unsigned flags) const {
 	int flag;
+	if (lazy && type != lept_type::string) {
+		stk.append(v.raw.text(), v.raw.len);
+		return;
+	}
 	switch (type) {
 		case lept_type::null: stk.append("null"); break;
 		case lept_type::boolean: stk.append(v.b ? "true" : "false"); break;
@@ -552,16 +835,16 @@ void lept_value::stringify_value(std::string& stk) const {
 		}
 			break;
 #if 1
-		case lept_type::string: stringify_string(stk); break;
+		case lept_type::string: stringify_string(stk, flags); break;
 #endif
 #if 1
 		case lept_type::array:
 			stk.push_back('[');
 			flag = 0;
-			for (auto val : v.arr) {
+			for (auto& val : *v.arr) {
 				if (flag) stk.push_back(',');
 				else flag |= 1;
-				val.stringify_value(stk);
+				val.stringify_value(stk, flags);
 			}
 			stk.push_back(']');
 			break;
@@ -570,14 +853,10 @@ void lept_value::stringify_value(std::string& stk) const {
 		case lept_type::object:
 			stk.push_back('{');
 			flag = 0;
-			for (auto &item : v.obj) {
+			for (auto &item : *v.obj) {
 				if (flag) stk.push_back(',');
 				else flag |= 1;
-				stk.push_back('\"');
-				stk.append(item.first);
-				stk.push_back('\"');
-				stk.push_back(':');
-				item.second.stringify_value(stk);
+				stringify_member(stk, item, flags);
 			}
 			stk.push_back('}');
 			break;
@@ -587,12 +866,328 @@ void lept_value::stringify_value(std::string& stk) const {
 	}
 }
 
+void lept_value::stringify_member(std::string& stk, const object_t::value_type& item, unsigned flags) {
+	stringify_escaped(stk, item.first, flags);
+	stk.push_back(':');
+	item.second.stringify_value(stk, flags);
+}
+
 std::string lept_value::stringify() const{
 	std::string stk;
 	stringify_value(stk);
 	return stk;
 }
 
+std::string lept_value::stringify(unsigned flags) const {
+	std::string stk;
+	stringify_value(stk, flags);
+	return stk;
+}
+
+/* Children go out in about this many pieces per thread, so a few large
+ * ones do not leave the other threads idle. */
+static const size_t LEPT_STRINGIFY_CHUNKS_PER_THREAD = 4;
+
+void lept_value::stringify_chunks(std::vector<std::string>& chunks, unsigned threads) const {
+	chunks.clear();
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t n = type == lept_type::array ? v.arr->size() : type == lept_type::object ? v.obj->size() : 0;
+	if (threads < 2 || n < 2) {
+		chunks.emplace_back();
+		stringify_value(chunks.back());
+		return;
+	}
+
+	/* random access to the members of a map */
+	std::vector<const object_t::value_type*> members;
+	if (type == lept_type::object) {
+		members.reserve(n);
+		for (auto& item : *v.obj)
+			members.push_back(&item);
+	}
+	size_t count = std::min(n, (size_t)threads * LEPT_STRINGIFY_CHUNKS_PER_THREAD);
+	chunks.resize(count);
+	std::atomic<size_t> next(0);
+	auto work = [&] {
+		size_t c;
+		while ((c = next.fetch_add(1, std::memory_order_relaxed)) < count) {
+			std::string& out = chunks[c];
+			size_t begin = n * c / count, end = n * (c + 1) / count;
+			for (size_t i = begin; i < end; i++) {
+				if (i)
+					out.push_back(',');
+				if (type == lept_type::array)
+					(*v.arr)[i].stringify_value(out);
+				else
+					stringify_member(out, *members[i]);
+			}
+		}
+	};
+	std::vector<std::thread> pool;
+	for (unsigned t = 1; t < threads && t < count; t++)
+		pool.emplace_back(work);
+	work();
+	for (auto& t : pool)
+		t.join();
+	chunks.front().insert(chunks.front().begin(), type == lept_type::array ? '[' : '{');
+	chunks.back().push_back(type == lept_type::array ? ']' : '}');
+}
+
+std::string lept_value::stringify_parallel(unsigned threads) const {
+	std::vector<std::string> chunks;
+	stringify_chunks(chunks, threads);
+	if (chunks.size() == 1)
+		return std::move(chunks[0]);
+	size_t total = 0;
+	for (auto& c : chunks)
+		total += c.size();
+	std::string out;
+	out.reserve(total);
+	for (auto& c : chunks)
+		out += c;
+	return out;
+}
+
+#ifdef LEPT_HAVE_WRITEV
+int lept_value::stringify_parallel_fd(int fd, unsigned threads) const {
+	std::vector<std::string> chunks;
+	stringify_chunks(chunks, threads);
+	std::vector<struct iovec> iov;
+	for (auto& c : chunks)
+		if (!c.empty())
+			iov.push_back({ (void*)c.data(), c.size() });
+	size_t first = 0;
+	while (first < iov.size()) {
+		int batch = (int)std::min(iov.size() - first, (size_t)IOV_MAX);
+		ssize_t n = writev(fd, &iov[first], batch);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			/* EAGAIN included: a non-blocking fd that is full is not waited on */
+			return LEPT_STRINGIFY_IO_ERROR;
+		}
+		if (n == 0)
+			return LEPT_STRINGIFY_IO_ERROR;
+		/* skip what was written, possibly ending inside a buffer */
+		size_t done = (size_t)n;
+		while (first < iov.size() && done >= iov[first].iov_len)
+			done -= iov[first++].iov_len;
+		if (done) {
+			iov[first].iov_base = (char*)iov[first].iov_base + done;
+			iov[first].iov_len -= done;
+		}
+	}
+	return LEPT_STRINGIFY_OK;
+}
+#endif
+
+/* Red-black tree nodes carry a color and three links ahead of the value in
+ * the common standard library implementations. */
+static const size_t LEPT_MAP_NODE_SIZE = 4 * sizeof(void*) + sizeof(lept_value::object_t::value_type);
+
+static size_t string_heap_bytes(const std::string& s, size_t& slack) {
+	const char* p = s.data();
+	const char* self = reinterpret_cast<const char*>(&s);
+	if (p >= self && p < self + sizeof(s))
+		return 0;	/* short string stored inline */
+	slack += s.capacity() - s.size();
+	return s.capacity() + 1;
+}
+
+void lept_value::add_memory_usage(lept_memory_usage& usage, std::unordered_set<const void*>& seen) const {
+	switch (type) {
+		case lept_type::string:
+			if (!lazy)
+				usage.strings += string_heap_bytes(v.s, usage.slack);
+			else if (const std::string* s = v.view.copy.load(std::memory_order_acquire))
+				usage.strings += sizeof(std::string) + string_heap_bytes(*s, usage.slack);
+			break;
+		case lept_type::integer:
+		case lept_type::number:
+			/* the text of a long lazy number */
+			if (lazy && v.raw.len > sizeof(v.raw.small))
+				usage.strings += v.raw.len;
+			break;
+		case lept_type::array:
+			if (!seen.insert(v.arr.get()).second)
+				break;
+			usage.arrays += v.arr->capacity() * sizeof(lept_value);
+			usage.slack += (v.arr->capacity() - v.arr->size()) * sizeof(lept_value);
+			for (auto& e : *v.arr)
+				e.add_memory_usage(usage, seen);
+			break;
+		case lept_type::object:
+			if (!seen.insert(v.obj.get()).second)
+				break;
+			usage.objects += v.obj->size() * LEPT_MAP_NODE_SIZE;
+			for (auto& item : *v.obj) {
+				usage.strings += string_heap_bytes(item.first, usage.slack);
+				item.second.add_memory_usage(usage, seen);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+lept_memory_usage lept_value::memory_usage() const {
+	lept_memory_usage usage = {};
+	std::unordered_set<const void*> seen;
+	add_memory_usage(usage, seen);
+	return usage;
+}
+
+void lept_value::compact() {
+	switch (type) {
+		case lept_type::string:
+			if (!lazy)
+				v.s.shrink_to_fit();
+			break;
+		case lept_type::array:
+			/* shrinking shared storage would race with its other holders */
+			if (!sole_owner(v.arr))
+				break;
+			for (auto& e : *v.arr)
+				e.compact();
+			v.arr->shrink_to_fit();
+			break;
+		case lept_type::object:
+		{
+			/* keys are const inside the map, so move every node out, shrink it
+			 * and relink it into a fresh tree in order */
+			if (!sole_owner(v.obj))
+				break;
+			object_t& obj = *v.obj;
+			object_t tmp;
+			while (!obj.empty()) {
+				auto node = obj.extract(obj.begin());
+				node.key().shrink_to_fit();
+				node.mapped().compact();
+				tmp.insert(tmp.end(), std::move(node));
+			}
+			obj.swap(tmp);
+		}
+			break;
+		default:
+			break;
+	}
+}
+
+bool lept_value::operator==(const lept_value& rhs) const {
+	if (type != rhs.type) {
+		if (type == lept_type::integer && rhs.type == lept_type::number)
+			return get_integer() == rhs.get_number();
+		if (type == lept_type::number && rhs.type == lept_type::integer)
+			return get_number() == rhs.get_integer();
+		return false;
+	}
+	switch (type) {
+		case lept_type::null: return true;
+		case lept_type::boolean: return v.b == rhs.v.b;
+		case lept_type::integer: return get_integer() == rhs.get_integer();
+		case lept_type::number: return get_number() == rhs.get_number();
+		case lept_type::string: return get_string_view() == rhs.get_string_view();
+		case lept_type::array:
+			if (v.arr == rhs.v.arr)
+				return true;
+			if (v.arr->size() != rhs.v.arr->size())
+				return false;
+			for (size_t i = 0; i < v.arr->size(); i++)
+				if ((*v.arr)[i] != (*rhs.v.arr)[i])
+					return false;
+			return true;
+		case lept_type::object:
+			if (v.obj == rhs.v.obj)
+				return true;
+			if (v.obj->size() != rhs.v.obj->size())
+				return false;
+			/* both maps are sorted the same way */
+			for (auto i = v.obj->begin(), j = rhs.v.obj->begin(); i != v.obj->end(); ++i, ++j)
+				if (i->first != j->first || i->second != j->second)
+					return false;
+			return true;
+	}
+	return false;
+}
+
+/* 64-bit FNV-1a and a finalizer from splitmix64; fixed constants keep the
+ * hash the same across runs and platforms. */
+static uint64_t hash_bytes(const void* data, size_t len, uint64_t h) {
+	const unsigned char* p = (const unsigned char*)data;
+	for (size_t i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static uint64_t hash_mix(uint64_t x) {
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+static const uint64_t LEPT_HASH_SEED = 0xcbf29ce484222325ULL;
+
+template<typename F>
+static uint64_t hash_value(const lept_value& v, F&& child) {
+	switch (v.get_type()) {
+		case lept_type::null: return hash_mix(1);
+		case lept_type::boolean: return hash_mix(v.get_boolean() ? 2 : 3);
+		case lept_type::integer:
+		case lept_type::number:
+		{
+			/* one hash for 1 and 1.0, and for 0 and -0 */
+			double d = v.get_type() == lept_type::integer ? v.get_integer() : v.get_number();
+			if (d == 0)
+				d = 0;
+			uint64_t bits;
+			memcpy(&bits, &d, sizeof(bits));
+			return hash_mix(bits ^ 4);
+		}
+		case lept_type::string:
+		{
+			std::string_view s = v.get_string_view();
+			return hash_mix(hash_bytes(s.data(), s.size(), LEPT_HASH_SEED) ^ 5);
+		}
+		case lept_type::array:
+		{
+			uint64_t h = hash_mix(6 + v.get_array_size());
+			for (size_t i = 0; i < v.get_array_size(); i++)
+				h = hash_mix(h ^ child(v.get_array_element(i)));
+			return h;
+		}
+		case lept_type::object:
+		{
+			/* a sum of per-member hashes does not depend on member order */
+			uint64_t h = 0;
+			for (auto& item : v.get_object()) {
+				uint64_t k = hash_bytes(item.first.data(), item.first.size(), LEPT_HASH_SEED);
+				h += hash_mix(k ^ (child(item.second) * 0x9e3779b97f4a7c15ULL));
+			}
+			return hash_mix(h ^ (7 + v.get_object_size()));
+		}
+	}
+	return 0;
+}
+
+size_t lept_hash(const lept_value& v) {
+	return (size_t)hash_value(v, [](const lept_value& c) { return (uint64_t)lept_hash(c); });
+}
+
+size_t lept_hash_cache::operator()(const lept_value& v) {
+	auto it = memo.find(&v);
+	if (it != memo.end())
+		return it->second;
+	size_t h = (size_t)hash_value(v, [this](const lept_value& c) { return (uint64_t)(*this)(c); });
+	memo.emplace(&v, h);
+	return h;
+}
+
 lept_value::lept_value(const std::string& s)
 {
 	this->type = lept_type::string;
@@ -620,10 +1215,10 @@ lept_value::lept_value(int i)
 lept_value::lept_value(array_t&& arr)
 {
 	this->type = lept_type::array;
-	new(&v.arr) std::vector<lept_value>(arr);
+	new(&v.arr) shared_array(lept_make_shared<array_t>(std::move(arr)));
 }
 
-lept_value::lept_value(const array_t& arr)
+lept_value::lept_value(const array_t& arr) : type(lept_type::null)
 {
 	set_array(arr);
 }
@@ -631,10 +1226,10 @@ lept_value::lept_value(const array_t& arr)
 lept_value::lept_value(object_t&& obj)
 {
 	this->type = lept_type::object;
-	new(&v.obj) std::map<std::string, lept_value>(obj);
+	new(&v.obj) shared_object(lept_make_shared<object_t>(std::move(obj)));
 }
 
-lept_value::lept_value(const object_t& obj) {
+lept_value::lept_value(const object_t& obj) : type(lept_type::null) {
 	set_object(obj);
 }
 
@@ -644,20 +1239,20 @@ lept_value::lept_value(std::nullptr_t) noexcept
 }
 
 
-lept_value::lept_value(std::initializer_list<lept_value> initList)
+lept_value::lept_value(std::initializer_list<lept_value> initList) : type(lept_type::null)
 {
 	bool is_an_object = std::all_of(initList.begin(), initList.end(),
 		[](const lept_value& ele)
 		{
-			return ele.type == lept_type::array && ele.v.arr.size() == 2
-				&& ele.v.arr[0].type == lept_type::string;
+			return ele.type == lept_type::array && ele.v.arr->size() == 2
+				&& (*ele.v.arr)[0].type == lept_type::string;
 		});
 	if (is_an_object)
 	{
 		object_t obj;
 		for (auto &it : initList)
 		{
-			obj.emplace(it.v.arr[0].v.s, it.v.arr[1]);
+			obj.emplace((*it.v.arr)[0].v.s, (*it.v.arr)[1]);
 		}
 
 		this->set_object(std::move(obj));
@@ -3,43 +3,200 @@
 #include <cassert>
 #include <stddef.h>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
 #include <initializer_list>
+#include "leptjson_pool.h"
+#if defined(__unix__) || defined(__APPLE__)
+#define LEPT_HAVE_WRITEV 1
+#endif
+
+/* Allocator of array and object storage and of their shared control
+ * blocks: the thread-local pools when built with LEPT_POOL. */
+#ifdef LEPT_POOL
+template<typename T>
+using lept_container_allocator = lept_pool_allocator<T>;
+#else
+template<typename T>
+using lept_container_allocator = std::allocator<T>;
+#endif
+
 enum class lept_type { null, boolean, number, integer, string, array, object };
 
 class lept_value;
 
+/* What const lept_value::get<T>() returns: a reference into the value,
+ * except for numbers, which may be held as text and are converted by value. */
+template<typename T>
+struct lept_get_result { using type = const T&; };
+template<typename T>
+struct lept_get_result<const T> : lept_get_result<T> {};
+template<>
+struct lept_get_result<double> { using type = double; };
+template<>
+struct lept_get_result<int> { using type = int; };
+
+enum {
+	LEPT_PHASE_WHITESPACE = 0,
+	LEPT_PHASE_LITERAL,
+	LEPT_PHASE_NUMBER,
+	LEPT_PHASE_STRING,
+	LEPT_PHASE_TOTAL,
+	LEPT_PHASE_COUNT
+};
+
+/* Filled by lept_value::parse(json, stats).  Collection is compiled in only
+ * when the library is built with LEPT_PARSE_STATS; otherwise the struct is
+ * zeroed and enabled stays false. */
+struct lept_parse_stats
+{
+	bool enabled;
+	size_t bytes;					/* input consumed */
+	size_t nodes[(int)lept_type::object + 1];	/* values produced, by lept_type */
+	size_t max_depth;
+	size_t string_bytes;				/* decoded bytes of strings and keys */
+	size_t escapes;
+	size_t number_fast;				/* integers */
+	size_t number_slow;				/* doubles through double-conversion */
+	unsigned long long cycles[LEPT_PHASE_COUNT];
+};
+
+/* Heap bytes held by a subtree, see lept_value::memory_usage().  slack is the
+ * part of the other counters that is allocated but unused capacity.  A
+ * container shared by several copies within the subtree is counted once. */
+struct lept_memory_usage
+{
+	size_t strings;		/* string values and object keys */
+	size_t arrays;		/* element storage of arrays */
+	size_t objects;		/* map nodes of objects */
+	size_t slack;
+
+	size_t total() const { return strings + arrays + objects; }
+};
+
+/* The members to keep when parsing with a mask, as a tree of dotted paths:
+ * {"user.id", "items.sku"} keeps user.id and the sku of every element of
+ * items.  Arrays are transparent; a path ending at a member keeps all of
+ * it.  Members not on any path are skipped during parsing without being
+ * built. */
+class lept_field_mask
+{
+public:
+	lept_field_mask() : keep_all(false) {}
+	lept_field_mask(std::initializer_list<std::string_view> paths);
+
+	void add(std::string_view dotted);
+	void add(const std::vector<std::string>& path);
+
+	/* nullptr when key is not kept */
+	const lept_field_mask* find(std::string_view key) const;
+	bool all() const { return keep_all; }
+
+private:
+	bool keep_all;
+	std::vector<std::pair<std::string, lept_field_mask>> members;	/* sorted */
 
+	lept_field_mask& member(std::string_view key);
+};
 
+/* Copying a lept_value copies its whole subtree.  share() instead returns a
+ * handle to the same arrays and objects, copy-on-write: a container is
+ * cloned (one level deep, children stay shared) the first time a handle
+ * reaches it through a non-const accessor while another handle still shares
+ * it.  Read through const references to avoid needless clones.  Handles may
+ * be read and modified on different threads.
+ *
+ * A reference obtained from a mutable accessor aliases storage that a later
+ * share() of the parent sees:
+ *
+ *	lept_value& x = doc["x"];
+ *	lept_value handle = doc.share();
+ *	x = 1;				(handle["x"] is 1 as well)
+ *
+ * Take such references after sharing, or fetch them again; a plain copy
+ * never aliases. */
 class lept_value
 {
 public:
-	using object_t = std::map<std::string, lept_value>;
-	using array_t = std::vector<lept_value>;
+	using object_t = std::map<std::string, lept_value, std::less<std::string>,
+		lept_container_allocator<std::pair<const std::string, lept_value>>>;
+	using array_t = std::vector<lept_value, lept_container_allocator<lept_value>>;
 
 private:
+	using shared_array = std::shared_ptr<array_t>;
+	using shared_object = std::shared_ptr<object_t>;
+
+	/* A string pointing into the parsed input.  get_string() needs a
+	 * std::string: the first call makes one and publishes it in copy, so the
+	 * value itself never changes under concurrent const readers. */
+	struct borrowed_t {
+		std::string_view text;
+		mutable std::atomic<std::string*> copy;
+
+		explicit borrowed_t(std::string_view text) : text(text), copy(nullptr) {}
+	};
+
+	/* Text of a lazy number, inline when short.  value caches the first
+	 * conversion, NaN (no JSON number converts to it) until then; readers
+	 * racing to fill it store the same value. */
+	struct raw_t {
+		mutable std::atomic<double> value;
+		size_t len;
+		union {
+			char small[16];
+			char* heap;
+		};
+
+		const char* text() const { return len <= sizeof(small) ? small : heap; }
+	};
+
 	union u{
 		double n;
 		std::string s;
-		array_t arr;
-		object_t obj;
+		shared_array arr;
+		shared_object obj;
 		int i;
 		bool b;
+		borrowed_t view;
+		/* a number kept as its source text, see LEPT_PARSE_LAZY_NUMBERS */
+		raw_t raw;
 
 		u() {};
 		~u() {};
 	};
 	lept_type type;
+	bool lazy = false;	/* number or integer in v.raw, or string in v.view */
 	u v;
 
+	friend class lept_context;
+	friend class lept_writer;
 	void free();
-	void stringify_value(std::string &stk) const;
-	void stringify_string(std::string& stk) const;
+	void set_raw_number(lept_type t, const char* s, size_t len);
+	void set_borrowed(const char* s, size_t len);
+	void copy_lazy(const lept_value& val);
+	/* the lazy number converted, once */
+	double raw_value() const;
+	/* converts a lazy number or copies a borrowed string in place */
+	void resolve();
+	/* the container, cloned first if it is shared */
+	array_t& own_array();
+	object_t& own_object();
+	void stringify_value(std::string &stk, unsigned flags = 0) const;
+	void stringify_string(std::string& stk, unsigned flags) const;
+	static void stringify_member(std::string& stk, const object_t::value_type& item, unsigned flags = 0);
+	void stringify_chunks(std::vector<std::string>& chunks, unsigned threads) const;
+	void add_memory_usage(lept_memory_usage& usage, std::unordered_set<const void*>& seen) const;
 
 	public :
 	lept_value() noexcept ;
 	lept_value(const lept_value& val);
+	lept_value(lept_value&& val) noexcept;	/* leaves val null */
 	lept_value(const std::string& s);
 	lept_value(std::string&& s);
 	lept_value(double d);
@@ -50,7 +207,7 @@ private:
 	lept_value(const object_t& obj);
 	lept_value(std::nullptr_t) noexcept;
 	lept_value(const char* str) : lept_value(std::string(str)) {}
-	lept_value(bool b)
+	lept_value(bool b) : type(lept_type::null)
 	{
 		this->set_boolean(b);
 	}
@@ -58,10 +215,23 @@ private:
 	lept_value(std::initializer_list<lept_value> initList);
 
 	lept_value& operator=(lept_value val);
+	/* a copy-on-write handle to the same containers, see above */
+	lept_value share() const;
 
 	~lept_value() noexcept;
 
 	int parse(std::string json);
+	int parse(std::string json, lept_parse_stats& stats);
+	int parse(std::string json, unsigned flags);
+	/* Builds only what mask keeps.  Skipped values are not built but are
+	 * still checked: the same grammar, number range and depth limit. */
+	int parse(std::string json, const lept_field_mask& mask, unsigned flags = 0);
+	/* Parse without a copy of json.  parse_borrowed() points strings that
+	 * have no escapes into json; parse_insitu() also unescapes the others
+	 * over their source text, destroying json.  Either way the document
+	 * must not outlive json.  Object keys are always copied. */
+	int parse_borrowed(const char* json, unsigned flags = 0);
+	int parse_insitu(char* json, unsigned flags = 0);
 
 	static std::string typeStr(lept_type t);
 
@@ -84,13 +254,16 @@ private:
 	int get_integer() const;
 	void set_integer(int i);
 
+	/* A borrowed string is copied on first use into storage beside it;
+	 * get_string_view() never copies. */
 	const std::string& get_string() const;
+	std::string_view get_string_view() const;
 	void set_string(std::string);
 
 	size_t get_array_size() const;
 	lept_value& get_array_element(size_t index);
 	const lept_value& get_array_element(size_t index) const;
-	void set_array(std::vector<lept_value>&& val);
+	void set_array(array_t&& val);
 	void set_array(const array_t& arr);
 
 	bool contains_key(std::string key) const;
@@ -101,13 +274,13 @@ private:
 	const object_t& get_object() const
 	{
 		assert(type == lept_type::object);
-		return v.obj;
+		return *v.obj;
 	}
 
 	object_t& get_object()
 	{
 		assert(type == lept_type::object);
-		return v.obj;
+		return own_object();
 	}
 
 	template<typename T>
@@ -117,19 +290,19 @@ private:
 	T& get() ;
 
 	template<typename T>
-	const T& get() const ;
+	typename lept_get_result<T>::type get() const ;
 
 
 	lept_value& operator[](const std::string& key)
 	{
 		assert(type == lept_type::object);
-		return v.obj[key];
+		return own_object()[key];
 	}
 
 	const lept_value& operator[](const std::string& key) const
 	{
 		assert(type == lept_type::object);
-		return v.obj.at(key);
+		return v.obj->at(key);
 	}
 
 	const lept_value& operator[](int index) const
@@ -143,8 +316,56 @@ private:
 	}
 
 	std::string stringify() const;
+	std::string stringify(unsigned flags) const;	/* LEPT_STRINGIFY_* options */
+	/* Same output as stringify(), with the children of a top-level array or
+	 * object serialized on up to threads threads (0: one per core) and
+	 * joined in order.  stringify_parallel_fd() hands the pieces to writev()
+	 * instead of joining them and returns LEPT_STRINGIFY_*.  It does not wait
+	 * on a non-blocking fd: when that fills up, output stops partway with
+	 * LEPT_STRINGIFY_IO_ERROR. */
+	std::string stringify_parallel(unsigned threads = 0) const;
+#ifdef LEPT_HAVE_WRITEV
+	int stringify_parallel_fd(int fd, unsigned threads = 0) const;
+#endif
+
+	lept_memory_usage memory_usage() const;
+	/* Releases unused capacity.  Containers shared with other values are
+	 * left as they are rather than cloned. */
+	void compact();
+
+	/* Deep equality.  Integers and numbers compare by value, so 1 == 1.0. */
+	bool operator==(const lept_value& rhs) const;
+	bool operator!=(const lept_value& rhs) const { return !(*this == rhs); }
+};
+
+/* Structural hash consistent with operator==.  It depends only on content,
+ * not on the platform or the run; object members are combined without
+ * regard to order. */
+size_t lept_hash(const lept_value& v);
+
+/* lept_hash() remembering the hash of every subtree it visits, keyed by
+ * address.  Entries go stale when a value is modified or destroyed; call
+ * clear() (or forget() on each changed node and its ancestors) first. */
+class lept_hash_cache
+{
+public:
+	size_t operator()(const lept_value& v);
+	void forget(const lept_value& v) { memo.erase(&v); }
+	void clear() { memo.clear(); }
+	size_t size() const { return memo.size(); }
+
+private:
+	std::unordered_map<const lept_value*, size_t> memo;
 };
 
+namespace std {
+	template<>
+	struct hash<lept_value>
+	{
+		size_t operator()(const lept_value& v) const { return lept_hash(v); }
+	};
+}
+
 enum  {
 	LEPT_PARSE_OK = 0,
 	LEPT_PARSE_EXPECT_VALUE,
@@ -159,7 +380,35 @@ enum  {
 	LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET,
 	LEPT_PARSE_MISS_KEY,
 	LEPT_PARSE_MISS_COLON,
-	LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+	LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+	LEPT_PARSE_TYPE_MISMATCH,
+	LEPT_PARSE_INVALID_UTF8,
+	LEPT_PARSE_TOO_DEEP
+};
+
+/* Containers nested deeper than this fail with LEPT_PARSE_TOO_DEEP. */
+#define LEPT_PARSE_MAX_DEPTH 1024
+
+/* Options for lept_value::parse(json, flags). */
+enum {
+	LEPT_PARSE_STRICT_UTF8 = 1 << 0,	/* reject strings that are not well-formed UTF-8 */
+	/* Keep numbers as their source text, converted by the first
+	 * get_number()/get_integer() call and written back verbatim by
+	 * stringify(), so long decimals keep every digit.  Integers of more
+	 * than nine digits are numbers, as a converting parse makes those that
+	 * do not fit an int.  Any setter, or the mutable get<double>()/get<int>(),
+	 * replaces the text with the converted value. */
+	LEPT_PARSE_LAZY_NUMBERS = 1 << 1
+};
+
+enum {
+	LEPT_STRINGIFY_OK = 0,
+	LEPT_STRINGIFY_IO_ERROR
+};
+
+/* Options for lept_value::stringify(flags). */
+enum {
+	LEPT_STRINGIFY_ENSURE_ASCII = 1 << 0	/* write non-ASCII characters as \uXXXX */
 };
 
 template<typename T>
@@ -195,7 +444,7 @@ T& lept_value::get() {
 }
 
 template<typename T>
-const T& lept_value::get() const {
+typename lept_get_result<T>::type lept_value::get() const {
 	using U = typename std::remove_cv<typename std::remove_reference<T>::type>::type;
 	return get<U>();
 }
@@ -218,12 +467,48 @@ return (var); \
 }
 
 GET(bool, v.b);
-GET(double, v.n);
-GET(int, v.i);
 
-GET(std::string, v.s);
-GET(lept_value::array_t, v.arr);
-GET(lept_value::object_t, v.obj);
+
+/* a lazy number is converted by every const read; a mutable one keeps
+ * it converted so the reference has something to refer to */
+#define GET_NUMBER(ctype, var, getter) \
+template<> inline ctype lept_value::get<ctype>() const { \
+assert(is<ctype>()); \
+return getter(); \
+} \
+template<> inline ctype& lept_value::get<ctype>() { \
+assert(is<ctype>()); \
+resolve(); \
+return (var); \
+}
+
+GET_NUMBER(double, v.n, get_number);
+GET_NUMBER(int, v.i, get_integer);
+
+template<> inline const std::string& lept_value::get<std::string>() const {
+assert(is<std::string>());
+return get_string();
+}
+template<> inline std::string& lept_value::get<std::string>() {
+assert(is<std::string>());
+resolve();
+return v.s;
+}
+
+#define GET_SHARED(ctype, var, own) \
+template<> inline const ctype& lept_value::get<ctype>() const { \
+assert(is<ctype>()); \
+return *(var); \
+} \
+template<> inline ctype& lept_value::get<ctype>() { \
+assert(is<ctype>()); \
+return own(); \
+}
+
+GET_SHARED(lept_value::array_t, v.arr, own_array);
+GET_SHARED(lept_value::object_t, v.obj, own_object);
 
 #undef GET_STATIC
 #undef GET
+#undef GET_NUMBER
+#undef GET_SHARED
@@ -0,0 +1,199 @@
+#include "leptjson_async.h"
+#include <assert.h>
+#include <string.h>
+#include "leptjson_reader.h"
+
+lept_async_lexer::lept_async_lexer(bool decode)
+	: filled(0), base(0), pos(0), tok(0), scan(0), pinned((size_t)-1), token(0),
+	escaped(false), eof(false), finished(false), decode(decode), key(false), state(VALUE) {}
+
+char* lept_async_lexer::prepare(size_t n) {
+	/* drop what no token or pin still needs once it is most of the buffer */
+	size_t keep = token ? tok : pos;
+	if (pinned != (size_t)-1 && pinned - base < keep)
+		keep = pinned - base;
+	if (keep > 0 && keep >= filled / 2) {
+		memmove(&buf[0], buf.data() + keep, filled - keep);
+		filled -= keep;
+		base += keep;
+		pos -= keep;
+		tok -= keep;
+		scan -= keep;
+	}
+	if (buf.size() < filled + n)
+		buf.resize(filled + n > buf.size() * 2 ? filled + n : buf.size() * 2);
+	return &buf[filled];
+}
+
+void lept_async_lexer::commit(size_t n) {
+	assert(filled + n <= buf.size());
+	if (n == 0)
+		eof = true;
+	filled += n;
+}
+
+/* Finds the end of the unfinished token; false if the input runs out first. */
+bool lept_async_lexer::scan_token() {
+	const char* s = buf.data();
+	if (token == '\"') {
+		for (; scan < filled; scan++) {
+			if (escaped)
+				escaped = false;
+			else if (s[scan] == '\\')
+				escaped = true;
+			else if (s[scan] == '\"') {
+				pos = scan + 1;
+				return true;
+			}
+		}
+		return false;
+	}
+	/* numbers and literals run to the first byte that cannot continue them;
+	 * the reader or parse() decides whether that much makes sense */
+	for (; scan < filled; scan++) {
+		char ch = s[scan];
+		if (token == '0' ? !((ch >= '0' && ch <= '9') || ch == '-' || ch == '+' || ch == '.' || ch == 'e' || ch == 'E')
+			: !(ch >= 'a' && ch <= 'z'))
+			break;
+	}
+	if (scan == filled && !eof)
+		return false;
+	pos = scan;
+	return true;
+}
+
+int lept_async_lexer::end_token(lept_event& e) {
+	token = 0;
+	if (key) {
+		e.type = lept_event::KEY;
+		state = COLON;
+	}
+	else {
+		e.type = lept_event::VALUE;
+		end_value();
+	}
+	if (!decode)
+		return LEPT_PARSE_OK;
+	lept_reader r(std::string_view(buf.data() + tok, pos - tok));
+	int ret;
+	if (key) {
+		std::string name;
+		if ((ret = r.read_string(name)) == LEPT_PARSE_OK)
+			e.value.set_string(std::move(name));
+	}
+	else
+		ret = r.read_value(e.value);
+	if (ret != LEPT_PARSE_OK)
+		pos = tok + r.offset();
+	/* "1-2" or "truex": the rest is left for the grammar to reject */
+	else if (r.offset() < pos - tok)
+		pos = tok + r.offset();
+	return ret;
+}
+
+void lept_async_lexer::end_value() {
+	state = stack.empty() ? TRAILER : COMMA;
+}
+
+/* The input ended between tokens. */
+int lept_async_lexer::at_end() {
+	switch (state) {
+		case TRAILER:
+			finished = true;
+			return LEPT_PARSE_OK;
+		case FIRST_KEY:
+		case KEY:
+			return LEPT_PARSE_MISS_KEY;
+		case COLON:
+			return LEPT_PARSE_MISS_COLON;
+		case COMMA:
+			return stack.back() == '[' ? LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+		default:
+			return LEPT_PARSE_EXPECT_VALUE;
+	}
+}
+
+int lept_async_lexer::next(lept_event& e, bool& need_input) {
+	need_input = false;
+	while (!token) {
+		const char* s = buf.data();
+		while (pos < filled && (s[pos] == ' ' || s[pos] == '\t' || s[pos] == '\n' || s[pos] == '\r'))
+			pos++;
+		if (pos == filled) {
+			if (eof)
+				return at_end();
+			need_input = true;
+			return LEPT_PARSE_OK;
+		}
+		char ch = s[pos];
+		tok = pos;
+		switch (state) {
+			case TRAILER:
+				return LEPT_PARSE_ROOT_NOT_SINGULAR;
+			case COLON:
+				if (ch != ':')
+					return LEPT_PARSE_MISS_COLON;
+				pos++;
+				state = VALUE;
+				continue;
+			case COMMA:
+				if (ch == ',') {
+					pos++;
+					state = stack.back() == '[' ? VALUE : KEY;
+					continue;
+				}
+				if (ch != (stack.back() == '[' ? ']' : '}'))
+					return stack.back() == '[' ? LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+				break;
+			case FIRST_KEY:
+				if (ch == '}')
+					break;
+				/* fall through */
+			case KEY:
+				if (ch != '\"')
+					return LEPT_PARSE_MISS_KEY;
+				key = true;
+				token = '\"';
+				scan = pos + 1;
+				continue;
+			case FIRST_ELEMENT:
+				if (ch == ']')
+					break;
+				/* fall through */
+			case VALUE:
+				key = false;
+				scan = pos;
+				if (ch == '[' || ch == '{') {
+					pos++;
+					stack.push_back(ch);
+					state = ch == '[' ? FIRST_ELEMENT : FIRST_KEY;
+					e.type = ch == '[' ? lept_event::BEGIN_ARRAY : lept_event::BEGIN_OBJECT;
+					return LEPT_PARSE_OK;
+				}
+				if (ch == '\"') {
+					token = '\"';
+					scan = pos + 1;
+				}
+				else if (ch == '-' || (ch >= '0' && ch <= '9'))
+					token = '0';
+				else if (ch >= 'a' && ch <= 'z')
+					token = 'a';
+				else
+					return LEPT_PARSE_INVALID_VALUE;
+				continue;
+		}
+		/* a closing bracket */
+		pos++;
+		e.type = stack.back() == '[' ? lept_event::END_ARRAY : lept_event::END_OBJECT;
+		stack.pop_back();
+		end_value();
+		return LEPT_PARSE_OK;
+	}
+	if (!scan_token()) {
+		if (eof)
+			return LEPT_PARSE_MISS_QUOTATION_MARK;
+		need_input = true;
+		return LEPT_PARSE_OK;
+	}
+	return end_token(e);
+}
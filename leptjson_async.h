@@ -0,0 +1,243 @@
+#pragma once
+
+#include <stddef.h>
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "leptjson.h"
+
+/* Parsing a document that arrives piece by piece, as C++20 coroutines
+ * (built with LEPTJSON_CXX20).
+ *
+ * A source is any object with read(char* buf, size_t len) returning
+ * something to co_await whose result is how many bytes it stored, 0 at the
+ * end of input: the awaitable counterpart of lept_source.  The parser
+ * suspends on it whenever it runs out of input, so no thread waits for the
+ * rest of a body:
+ *
+ *	auto elements = lept_async_elements(body);
+ *	while (co_await elements.next())
+ *		handle(elements.value());
+ *	if (elements.error() != LEPT_PARSE_OK)
+ *		...
+ *
+ * The source must outlive the generator.  offset, if given, receives where
+ * parsing stopped. */
+
+#define LEPT_ASYNC_CHUNK 4096
+
+template<typename T>
+class lept_async_generator
+{
+public:
+	struct promise_type;
+	using handle_type = std::coroutine_handle<promise_type>;
+
+	struct promise_type
+	{
+		T* current = nullptr;
+		std::coroutine_handle<> consumer;
+		std::exception_ptr exception;
+		int error = LEPT_PARSE_OK;
+
+		/* hands control back to the coroutine waiting in next() */
+		struct resume_consumer
+		{
+			bool await_ready() const noexcept { return false; }
+			std::coroutine_handle<> await_suspend(handle_type h) noexcept { return h.promise().consumer; }
+			void await_resume() const noexcept {}
+		};
+
+		lept_async_generator get_return_object() { return lept_async_generator(handle_type::from_promise(*this)); }
+		std::suspend_always initial_suspend() const noexcept { return {}; }
+		resume_consumer final_suspend() const noexcept { return {}; }
+		resume_consumer yield_value(T& v) noexcept
+		{
+			current = &v;
+			return {};
+		}
+		void return_value(int ret) noexcept { error = ret; }
+		void unhandled_exception() noexcept { exception = std::current_exception(); }
+	};
+
+	struct next_awaiter
+	{
+		handle_type h;
+
+		bool await_ready() const noexcept { return h.done(); }
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) noexcept
+		{
+			h.promise().consumer = consumer;
+			return h;
+		}
+		bool await_resume() const
+		{
+			if (h.promise().exception)
+				std::rethrow_exception(h.promise().exception);
+			return !h.done();
+		}
+	};
+
+	lept_async_generator(lept_async_generator&& rhs) noexcept : h(std::exchange(rhs.h, nullptr)) {}
+	lept_async_generator& operator=(lept_async_generator rhs) noexcept
+	{
+		std::swap(h, rhs.h);
+		return *this;
+	}
+	~lept_async_generator()
+	{
+		if (h)
+			h.destroy();
+	}
+
+	/* Resumes parsing until the next item; false once the input is used
+	 * up or an error stopped it. */
+	next_awaiter next() { return next_awaiter{ h }; }
+	/* the current item, valid until the next call to next() */
+	T& value() const { return *h.promise().current; }
+	/* LEPT_PARSE_OK, or the code that ended the sequence early */
+	int error() const { return h.promise().error; }
+
+private:
+	explicit lept_async_generator(handle_type h) : h(h) {}
+	handle_type h;
+};
+
+struct lept_event
+{
+	enum type_t { VALUE, KEY, BEGIN_ARRAY, END_ARRAY, BEGIN_OBJECT, END_OBJECT };
+
+	type_t type;
+	/* VALUE: the scalar; KEY: the member name as a string */
+	lept_value value;
+};
+
+/* The incremental tokenizer behind the generators; it holds the buffered
+ * input and the nesting of the containers still open. */
+class lept_async_lexer
+{
+public:
+	/* Without decode, VALUE and KEY events leave e.value alone. */
+	explicit lept_async_lexer(bool decode = true);
+
+	/* Room for n more bytes of input; commit() then says how many were
+	 * stored, 0 meaning the input has ended. */
+	char* prepare(size_t n);
+	void commit(size_t n);
+
+	/* The next event.  need_input is set instead when the buffered input
+	 * runs out first, and done() once only whitespace was left. */
+	int next(lept_event& e, bool& need_input);
+	bool done() const { return finished; }
+
+	size_t offset() const { return base + pos; }
+	/* where the token of the last event starts */
+	size_t token_offset() const { return base + tok; }
+	/* containers open after the last event */
+	size_t depth() const { return stack.size(); }
+
+	/* Keeps the input from offset at on buffered, for text(), until unpin(). */
+	void pin(size_t at) { pinned = at; }
+	void unpin() { pinned = (size_t)-1; }
+	std::string_view text(size_t from, size_t to) const { return std::string_view(buf.data() + (from - base), to - from); }
+
+private:
+	enum state_t { VALUE, FIRST_ELEMENT, FIRST_KEY, KEY, COLON, COMMA, TRAILER };
+
+	std::string buf;
+	size_t filled;
+	size_t base;		/* offset of buf[0] in the input */
+	size_t pos;
+	size_t tok;
+	size_t scan;		/* how far an unfinished token has been scanned */
+	size_t pinned;
+	char token;			/* kind of the unfinished token, or 0 */
+	bool escaped;
+	bool eof;
+	bool finished;
+	bool decode;
+	bool key;
+	state_t state;
+	std::vector<char> stack;
+
+	int at_end();
+	bool scan_token();
+	int end_token(lept_event& e);
+	void end_value();
+};
+
+/* Each element of the top-level array, parsed with lept_value::parse(json,
+ * flags) as soon as its last byte arrives.  A document that is not an
+ * array is yielded whole. */
+template<typename Source>
+lept_async_generator<lept_value> lept_async_elements(Source& src, unsigned flags = 0, size_t* offset = nullptr)
+{
+	lept_async_lexer lex(false);
+	lept_event e;
+	lept_value v;
+	bool need_input;
+	size_t level = 0, start = 0;
+	bool first = true;
+	int ret;
+	for (;;) {
+		if ((ret = lex.next(e, need_input)) != LEPT_PARSE_OK || lex.done())
+			break;
+		if (need_input) {
+			size_t n = co_await src.read(lex.prepare(LEPT_ASYNC_CHUNK), LEPT_ASYNC_CHUNK);
+			lex.commit(n);
+			continue;
+		}
+		bool begin = e.type == lept_event::BEGIN_ARRAY || e.type == lept_event::BEGIN_OBJECT;
+		if (first) {
+			first = false;
+			if (e.type == lept_event::BEGIN_ARRAY) {
+				level = 1;
+				continue;
+			}
+		}
+		if ((begin || e.type == lept_event::VALUE) && lex.depth() - (begin ? 1 : 0) == level) {
+			start = lex.token_offset();
+			lex.pin(start);
+		}
+		if ((e.type == lept_event::VALUE || e.type == lept_event::END_ARRAY || e.type == lept_event::END_OBJECT)
+			&& lex.depth() == level) {
+			if ((ret = v.parse(std::string(lex.text(start, lex.offset())), flags)) != LEPT_PARSE_OK) {
+				if (offset)
+					*offset = start;
+				co_return ret;
+			}
+			lex.unpin();
+			co_yield v;
+		}
+	}
+	if (offset)
+		*offset = lex.offset();
+	co_return ret;
+}
+
+/* The document as a stream of events, in text order: a KEY before each
+ * member's value, BEGIN and END around each container. */
+template<typename Source>
+lept_async_generator<lept_event> lept_async_events(Source& src, size_t* offset = nullptr)
+{
+	lept_async_lexer lex;
+	lept_event e;
+	bool need_input;
+	int ret;
+	for (;;) {
+		if ((ret = lex.next(e, need_input)) != LEPT_PARSE_OK || lex.done())
+			break;
+		if (need_input) {
+			size_t n = co_await src.read(lex.prepare(LEPT_ASYNC_CHUNK), LEPT_ASYNC_CHUNK);
+			lex.commit(n);
+			continue;
+		}
+		co_yield e;
+	}
+	if (offset)
+		*offset = lex.offset();
+	co_return ret;
+}
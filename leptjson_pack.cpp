@@ -0,0 +1,531 @@
+#include "leptjson_pack.h"
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <utility>
+
+/**********************************  buffering  **************************************/
+
+lept_pack_encoder::~lept_pack_encoder() {
+	flush();
+}
+
+void lept_pack_encoder::flush() {
+	if (len) {
+		out.write(buf, len);
+		len = 0;
+	}
+}
+
+void lept_pack_encoder::put(const char* p, size_t n) {
+	if (n > sizeof(buf) - len)
+		flush();
+	if (n >= sizeof(buf)) {
+		out.write(p, n);
+		return;
+	}
+	memcpy(buf + len, p, n);
+	len += n;
+}
+
+void lept_pack_encoder::put_be(uint64_t x, int bytes) {
+	for (int i = bytes - 1; i >= 0; i--)
+		put((unsigned char)(x >> (8 * i)));
+}
+
+bool lept_pack_decoder::fill(size_t want) {
+	pos = 0;
+	len = in.read(buf, exact && want < sizeof(buf) ? want : sizeof(buf));
+	return len != 0;
+}
+
+int lept_pack_decoder::next(lept_value& v) {
+	if (pos == len && !fill(1))
+		return LEPT_PACK_END;
+	return decode_value(v, 0);
+}
+
+int lept_pack_decoder::get_be(uint64_t& x, int bytes) {
+	unsigned char c;
+	int ret;
+	x = 0;
+	for (int i = 0; i < bytes; i++) {
+		if (pos == len && !fill((size_t)(bytes - i)))
+			return LEPT_PACK_UNEXPECTED_END;
+		if ((ret = get(c)) != LEPT_PACK_OK)
+			return ret;
+		x = (x << 8) | c;
+	}
+	return LEPT_PACK_OK;
+}
+
+/* Appends in chunks so a corrupt length cannot trigger a huge allocation
+ * before the input runs out. */
+int lept_pack_decoder::get_string(std::string& s, uint64_t n) {
+	while (n > 0) {
+		if (pos == len && !fill((size_t)std::min<uint64_t>(n, sizeof(buf))))
+			return LEPT_PACK_UNEXPECTED_END;
+		size_t take = (size_t)std::min<uint64_t>(n, len - pos);
+		s.append(buf + pos, take);
+		pos += take;
+		n -= take;
+	}
+	return LEPT_PACK_OK;
+}
+
+static void set_int64(lept_value& v, int64_t x) {
+	if (x >= INT_MIN && x <= INT_MAX)
+		v.set_integer((int)x);
+	else
+		v.set_number((double)x);
+}
+
+static void set_uint64(lept_value& v, uint64_t x) {
+	if (x <= INT_MAX)
+		v.set_integer((int)x);
+	else
+		v.set_number((double)x);
+}
+
+static int set_double(lept_value& v, double d) {
+	if (!std::isfinite(d))
+		return LEPT_PACK_INVALID_TYPE;
+	v.set_number(d);
+	return LEPT_PACK_OK;
+}
+
+static double bits_to_double(uint64_t bits) {
+	double d;
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+static float bits_to_float(uint32_t bits) {
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+static uint64_t double_to_bits(double d) {
+	uint64_t bits;
+	memcpy(&bits, &d, sizeof(bits));
+	return bits;
+}
+
+/**********************************  MessagePack  **************************************/
+
+void lept_msgpack_encoder::put_string(std::string_view s) {
+	size_t n = s.size();
+	if (n < 32)
+		put((unsigned char)(0xa0 | n));
+	else if (n < 0x100) {
+		put(0xd9);
+		put_be(n, 1);
+	}
+	else if (n < 0x10000) {
+		put(0xda);
+		put_be(n, 2);
+	}
+	else {
+		put(0xdb);
+		put_be(n, 4);
+	}
+	put(s.data(), n);
+}
+
+void lept_msgpack_encoder::write(const lept_value& v) {
+	switch (v.get_type()) {
+		case lept_type::null: put(0xc0); break;
+		case lept_type::boolean: put(v.get_boolean() ? 0xc3 : 0xc2); break;
+		case lept_type::integer:
+		{
+			int i = v.get_integer();
+			if (i >= 0) {
+				if (i < 0x80) put((unsigned char)i);
+				else if (i < 0x100) { put(0xcc); put_be((uint64_t)i, 1); }
+				else if (i < 0x10000) { put(0xcd); put_be((uint64_t)i, 2); }
+				else { put(0xce); put_be((uint64_t)i, 4); }
+			}
+			else {
+				if (i >= -32) put((unsigned char)(int8_t)i);
+				else if (i >= -128) { put(0xd0); put_be((uint8_t)i, 1); }
+				else if (i >= -32768) { put(0xd1); put_be((uint16_t)i, 2); }
+				else { put(0xd2); put_be((uint32_t)i, 4); }
+			}
+		}
+			break;
+		case lept_type::number:
+			put(0xcb);
+			put_be(double_to_bits(v.get_number()), 8);
+			break;
+		case lept_type::string: put_string(v.get_string_view()); break;
+		case lept_type::array:
+		{
+			const lept_value::array_t& arr = v.get<lept_value::array_t>();
+			size_t n = arr.size();
+			if (n < 16) put((unsigned char)(0x90 | n));
+			else if (n < 0x10000) { put(0xdc); put_be(n, 2); }
+			else { put(0xdd); put_be(n, 4); }
+			for (auto& e : arr)
+				write(e);
+		}
+			break;
+		case lept_type::object:
+		{
+			const lept_value::object_t& obj = v.get_object();
+			size_t n = obj.size();
+			if (n < 16) put((unsigned char)(0x80 | n));
+			else if (n < 0x10000) { put(0xde); put_be(n, 2); }
+			else { put(0xdf); put_be(n, 4); }
+			for (auto& item : obj) {
+				put_string(item.first);
+				write(item.second);
+			}
+		}
+			break;
+	}
+}
+
+int lept_msgpack_decoder::decode_array(lept_value& v, uint64_t n, int depth) {
+	lept_value::array_t arr;
+	int ret;
+	arr.reserve((size_t)std::min<uint64_t>(n, 1024));
+	for (uint64_t i = 0; i < n; i++) {
+		arr.emplace_back();
+		if ((ret = decode_value(arr.back(), depth + 1)) != LEPT_PACK_OK)
+			return ret;
+	}
+	v.set_array(std::move(arr));
+	return LEPT_PACK_OK;
+}
+
+int lept_msgpack_decoder::decode_map(lept_value& v, uint64_t n, int depth) {
+	lept_value::object_t obj;
+	int ret;
+	for (uint64_t i = 0; i < n; i++) {
+		lept_value key, val;
+		if ((ret = decode_value(key, depth + 1)) != LEPT_PACK_OK)
+			return ret;
+		if (key.get_type() != lept_type::string)
+			return LEPT_PACK_INVALID_KEY;
+		if ((ret = decode_value(val, depth + 1)) != LEPT_PACK_OK)
+			return ret;
+		obj.emplace(key.get_string(), std::move(val));
+	}
+	v.set_object(std::move(obj));
+	return LEPT_PACK_OK;
+}
+
+int lept_msgpack_decoder::decode_value(lept_value& v, int depth) {
+	unsigned char c;
+	uint64_t x;
+	int ret;
+	if (depth > LEPT_PACK_MAX_DEPTH)
+		return LEPT_PACK_TOO_DEEP;
+	if ((ret = get(c)) != LEPT_PACK_OK)
+		return ret;
+
+	if (c <= 0x7f) {
+		v.set_integer(c);
+		return LEPT_PACK_OK;
+	}
+	if (c >= 0xe0) {
+		v.set_integer((int8_t)c);
+		return LEPT_PACK_OK;
+	}
+	if (c >= 0xa0 && c <= 0xbf) {
+		std::string s;
+		if ((ret = get_string(s, c & 0x1f)) != LEPT_PACK_OK)
+			return ret;
+		v.set_string(std::move(s));
+		return LEPT_PACK_OK;
+	}
+	if (c >= 0x90 && c <= 0x9f)
+		return decode_array(v, c & 0x0f, depth);
+	if (c >= 0x80 && c <= 0x8f)
+		return decode_map(v, c & 0x0f, depth);
+
+	switch (c) {
+		case 0xc0: v.set_null(); return LEPT_PACK_OK;
+		case 0xc2: v.set_boolean(false); return LEPT_PACK_OK;
+		case 0xc3: v.set_boolean(true); return LEPT_PACK_OK;
+		case 0xc4: case 0xc5: case 0xc6:
+		case 0xd9: case 0xda: case 0xdb:
+		{
+			static const int width[] = { 1, 2, 4 };
+			int w = width[c >= 0xd9 ? c - 0xd9 : c - 0xc4];
+			std::string s;
+			if ((ret = get_be(x, w)) != LEPT_PACK_OK || (ret = get_string(s, x)) != LEPT_PACK_OK)
+				return ret;
+			v.set_string(std::move(s));
+			return LEPT_PACK_OK;
+		}
+		case 0xca:
+			if ((ret = get_be(x, 4)) != LEPT_PACK_OK)
+				return ret;
+			return set_double(v, bits_to_float((uint32_t)x));
+		case 0xcb:
+			if ((ret = get_be(x, 8)) != LEPT_PACK_OK)
+				return ret;
+			return set_double(v, bits_to_double(x));
+		case 0xcc: case 0xcd: case 0xce: case 0xcf:
+			if ((ret = get_be(x, 1 << (c - 0xcc))) != LEPT_PACK_OK)
+				return ret;
+			set_uint64(v, x);
+			return LEPT_PACK_OK;
+		case 0xd0: case 0xd1: case 0xd2: case 0xd3:
+		{
+			int bytes = 1 << (c - 0xd0);
+			if ((ret = get_be(x, bytes)) != LEPT_PACK_OK)
+				return ret;
+			if (bytes < 8 && (x >> (bytes * 8 - 1)))
+				x |= ~(uint64_t)0 << (bytes * 8);
+			set_int64(v, (int64_t)x);
+			return LEPT_PACK_OK;
+		}
+		case 0xdc: case 0xdd:
+			if ((ret = get_be(x, c == 0xdc ? 2 : 4)) != LEPT_PACK_OK)
+				return ret;
+			return decode_array(v, x, depth);
+		case 0xde: case 0xdf:
+			if ((ret = get_be(x, c == 0xde ? 2 : 4)) != LEPT_PACK_OK)
+				return ret;
+			return decode_map(v, x, depth);
+		default:
+			return LEPT_PACK_INVALID_TYPE;
+	}
+}
+
+/**********************************  CBOR  **************************************/
+
+void lept_cbor_encoder::put_head(int major, uint64_t arg) {
+	unsigned char m = (unsigned char)(major << 5);
+	if (arg < 24)
+		put((unsigned char)(m | arg));
+	else if (arg < 0x100) { put(m | 24); put_be(arg, 1); }
+	else if (arg < 0x10000) { put(m | 25); put_be(arg, 2); }
+	else if (arg < 0x100000000ULL) { put(m | 26); put_be(arg, 4); }
+	else { put(m | 27); put_be(arg, 8); }
+}
+
+void lept_cbor_encoder::write(const lept_value& v) {
+	switch (v.get_type()) {
+		case lept_type::null: put(0xf6); break;
+		case lept_type::boolean: put(v.get_boolean() ? 0xf5 : 0xf4); break;
+		case lept_type::integer:
+		{
+			int64_t i = v.get_integer();
+			if (i >= 0)
+				put_head(0, (uint64_t)i);
+			else
+				put_head(1, (uint64_t)(-1 - i));
+		}
+			break;
+		case lept_type::number:
+			put(0xfb);
+			put_be(double_to_bits(v.get_number()), 8);
+			break;
+		case lept_type::string:
+		{
+			std::string_view s = v.get_string_view();
+			put_head(3, s.size());
+			put(s.data(), s.size());
+		}
+			break;
+		case lept_type::array:
+		{
+			const lept_value::array_t& arr = v.get<lept_value::array_t>();
+			put_head(4, arr.size());
+			for (auto& e : arr)
+				write(e);
+		}
+			break;
+		case lept_type::object:
+		{
+			const lept_value::object_t& obj = v.get_object();
+			put_head(5, obj.size());
+			for (auto& item : obj) {
+				put_head(3, item.first.size());
+				put(item.first.data(), item.first.size());
+				write(item.second);
+			}
+		}
+			break;
+	}
+}
+
+static double decode_half(uint16_t h) {
+	int exp = (h >> 10) & 0x1f;
+	int mant = h & 0x3ff;
+	double val;
+	if (exp == 0)
+		val = ldexp(mant, -24);
+	else if (exp != 31)
+		val = ldexp(mant + 1024, exp - 25);
+	else
+		val = mant == 0 ? INFINITY : NAN;
+	return (h & 0x8000) ? -val : val;
+}
+
+int lept_cbor_decoder::get_arg(unsigned char head, uint64_t& arg) {
+	int ai = head & 0x1f;
+	if (ai < 24) {
+		arg = (uint64_t)ai;
+		return LEPT_PACK_OK;
+	}
+	if (ai > 27)
+		return LEPT_PACK_INVALID_TYPE;
+	return get_be(arg, 1 << (ai - 24));
+}
+
+/* Indefinite-length strings: definite chunks of the same major type until a break. */
+int lept_cbor_decoder::decode_chunks(std::string& s, int major) {
+	unsigned char c;
+	uint64_t n;
+	int ret;
+	for (;;) {
+		if ((ret = get(c)) != LEPT_PACK_OK)
+			return ret;
+		if (c == 0xff)
+			return LEPT_PACK_OK;
+		if ((c >> 5) != major || (c & 0x1f) == 31)
+			return LEPT_PACK_INVALID_TYPE;
+		if ((ret = get_arg(c, n)) != LEPT_PACK_OK || (ret = get_string(s, n)) != LEPT_PACK_OK)
+			return ret;
+	}
+}
+
+int lept_cbor_decoder::decode_value(lept_value& v, int depth) {
+	unsigned char head;
+	int ret;
+	if ((ret = get(head)) != LEPT_PACK_OK)
+		return ret;
+	return decode_item(v, head, depth);
+}
+
+int lept_cbor_decoder::decode_item(lept_value& v, unsigned char head, int depth) {
+	int major = head >> 5;
+	bool indefinite = (head & 0x1f) == 31;
+	uint64_t arg = 0;
+	int ret;
+
+	if (depth > LEPT_PACK_MAX_DEPTH)
+		return LEPT_PACK_TOO_DEEP;
+	if (major != 7 && !(indefinite && major >= 2 && major <= 5)) {
+		if ((ret = get_arg(head, arg)) != LEPT_PACK_OK)
+			return ret;
+	}
+
+	switch (major) {
+		case 0:
+			set_uint64(v, arg);
+			return LEPT_PACK_OK;
+		case 1:
+			if (arg < ((uint64_t)1 << 63))
+				set_int64(v, -1 - (int64_t)arg);
+			else
+				v.set_number(-1.0 - (double)arg);
+			return LEPT_PACK_OK;
+		case 2:
+		case 3:
+		{
+			std::string s;
+			if (indefinite)
+				ret = decode_chunks(s, major);
+			else
+				ret = get_string(s, arg);
+			if (ret != LEPT_PACK_OK)
+				return ret;
+			v.set_string(std::move(s));
+			return LEPT_PACK_OK;
+		}
+		case 4:
+		{
+			lept_value::array_t arr;
+			unsigned char c;
+			if (!indefinite)
+				arr.reserve((size_t)std::min<uint64_t>(arg, 1024));
+			for (uint64_t i = 0; indefinite || i < arg; i++) {
+				if ((ret = get(c)) != LEPT_PACK_OK)
+					return ret;
+				if (indefinite && c == 0xff)
+					break;
+				arr.emplace_back();
+				if ((ret = decode_item(arr.back(), c, depth + 1)) != LEPT_PACK_OK)
+					return ret;
+			}
+			v.set_array(std::move(arr));
+			return LEPT_PACK_OK;
+		}
+		case 5:
+		{
+			lept_value::object_t obj;
+			unsigned char c;
+			for (uint64_t i = 0; indefinite || i < arg; i++) {
+				lept_value key, val;
+				if ((ret = get(c)) != LEPT_PACK_OK)
+					return ret;
+				if (indefinite && c == 0xff)
+					break;
+				if ((ret = decode_item(key, c, depth + 1)) != LEPT_PACK_OK)
+					return ret;
+				if (key.get_type() != lept_type::string)
+					return LEPT_PACK_INVALID_KEY;
+				if ((ret = decode_value(val, depth + 1)) != LEPT_PACK_OK)
+					return ret;
+				obj.emplace(key.get_string(), std::move(val));
+			}
+			v.set_object(std::move(obj));
+			return LEPT_PACK_OK;
+		}
+		case 6:
+			/* semantic tags carry no meaning for lept_value */
+			return decode_value(v, depth + 1);
+		default:
+			switch (head & 0x1f) {
+				case 20: v.set_boolean(false); return LEPT_PACK_OK;
+				case 21: v.set_boolean(true); return LEPT_PACK_OK;
+				case 22: case 23: v.set_null(); return LEPT_PACK_OK;
+				case 25:
+					if ((ret = get_be(arg, 2)) != LEPT_PACK_OK)
+						return ret;
+					return set_double(v, decode_half((uint16_t)arg));
+				case 26:
+					if ((ret = get_be(arg, 4)) != LEPT_PACK_OK)
+						return ret;
+					return set_double(v, bits_to_float((uint32_t)arg));
+				case 27:
+					if ((ret = get_be(arg, 8)) != LEPT_PACK_OK)
+						return ret;
+					return set_double(v, bits_to_double(arg));
+				default:
+					return LEPT_PACK_INVALID_TYPE;
+			}
+	}
+}
+
+/**********************************  entry points  **************************************/
+
+void lept_msgpack_encode(const lept_value& v, lept_sink& out) {
+	lept_msgpack_encoder enc(out);
+	enc.write(v);
+}
+
+int lept_msgpack_decode(lept_source& in, lept_value& v) {
+	lept_msgpack_decoder dec(in, true);
+	int ret = dec.next(v);
+	return ret == LEPT_PACK_END ? LEPT_PACK_UNEXPECTED_END : ret;
+}
+
+void lept_cbor_encode(const lept_value& v, lept_sink& out) {
+	lept_cbor_encoder enc(out);
+	enc.write(v);
+}
+
+int lept_cbor_decode(lept_source& in, lept_value& v) {
+	lept_cbor_decoder dec(in, true);
+	int ret = dec.next(v);
+	return ret == LEPT_PACK_END ? LEPT_PACK_UNEXPECTED_END : ret;
+}
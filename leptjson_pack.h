@@ -0,0 +1,141 @@
+#pragma once
+
+#include <stdint.h>
+#include "leptjson.h"
+#include "leptjson_stream.h"
+
+/* MessagePack and CBOR codecs mapping directly between lept_value and bytes.
+ *
+ * Integers are written in their shortest form and doubles as 64-bit floats.
+ * On decode, integers that do not fit lept_value's int become numbers, binary
+ * strings become strings and map keys must be strings.  CBOR tags are skipped
+ * and indefinite-length items are accepted. */
+
+enum {
+	LEPT_PACK_OK = 0,
+	LEPT_PACK_END,				/* clean end of input before a value */
+	LEPT_PACK_UNEXPECTED_END,
+	LEPT_PACK_INVALID_TYPE,
+	LEPT_PACK_INVALID_KEY,
+	LEPT_PACK_TOO_DEEP
+};
+
+#define LEPT_PACK_MAX_DEPTH 1024
+
+class lept_pack_encoder
+{
+public:
+	virtual ~lept_pack_encoder();
+	virtual void write(const lept_value& v) = 0;
+	void flush();
+
+protected:
+	explicit lept_pack_encoder(lept_sink& out) : out(out), len(0) {}
+	void put(unsigned char c)
+	{
+		if (len == sizeof(buf))
+			flush();
+		buf[len++] = (char)c;
+	}
+	void put(const char* p, size_t n);
+	void put_be(uint64_t x, int bytes);
+
+private:
+	lept_sink& out;
+	char buf[4096];
+	size_t len;
+};
+
+class lept_pack_decoder
+{
+public:
+	virtual ~lept_pack_decoder() {}
+	/* Decodes the next value; LEPT_PACK_END when the input is exhausted. */
+	int next(lept_value& v);
+
+protected:
+	/* Normally input is read ahead a buffer at a time.  With exact, no byte
+	 * past the values decoded so far is taken from the source, at the cost
+	 * of many small reads. */
+	lept_pack_decoder(lept_source& in, bool exact) : in(in), pos(0), len(0), exact(exact) {}
+	virtual int decode_value(lept_value& v, int depth) = 0;
+	/* refills the buffer with up to want bytes in exact mode */
+	bool fill(size_t want);
+	int get(unsigned char& c)
+	{
+		if (pos == len && !fill(1))
+			return LEPT_PACK_UNEXPECTED_END;
+		c = (unsigned char)buf[pos++];
+		return LEPT_PACK_OK;
+	}
+	int peek(unsigned char& c)
+	{
+		if (pos == len && !fill(1))
+			return LEPT_PACK_UNEXPECTED_END;
+		c = (unsigned char)buf[pos];
+		return LEPT_PACK_OK;
+	}
+	int get_be(uint64_t& x, int bytes);
+	int get_string(std::string& s, uint64_t n);
+
+private:
+	lept_source& in;
+	char buf[4096];
+	size_t pos;
+	size_t len;
+	bool exact;
+};
+
+class lept_msgpack_encoder : public lept_pack_encoder
+{
+public:
+	explicit lept_msgpack_encoder(lept_sink& out) : lept_pack_encoder(out) {}
+	void write(const lept_value& v) override;
+
+private:
+	void put_string(std::string_view s);
+};
+
+class lept_msgpack_decoder : public lept_pack_decoder
+{
+public:
+	explicit lept_msgpack_decoder(lept_source& in, bool exact = false) : lept_pack_decoder(in, exact) {}
+
+protected:
+	int decode_value(lept_value& v, int depth) override;
+
+private:
+	int decode_array(lept_value& v, uint64_t n, int depth);
+	int decode_map(lept_value& v, uint64_t n, int depth);
+};
+
+class lept_cbor_encoder : public lept_pack_encoder
+{
+public:
+	explicit lept_cbor_encoder(lept_sink& out) : lept_pack_encoder(out) {}
+	void write(const lept_value& v) override;
+
+private:
+	void put_head(int major, uint64_t arg);
+};
+
+class lept_cbor_decoder : public lept_pack_decoder
+{
+public:
+	explicit lept_cbor_decoder(lept_source& in, bool exact = false) : lept_pack_decoder(in, exact) {}
+
+protected:
+	int decode_value(lept_value& v, int depth) override;
+
+private:
+	int decode_item(lept_value& v, unsigned char head, int depth);
+	int get_arg(unsigned char head, uint64_t& arg);
+	int decode_chunks(std::string& s, int major);
+};
+
+/* The one-shot decoders read exactly one value from in; whatever follows it
+ * is left in the source. */
+void lept_msgpack_encode(const lept_value& v, lept_sink& out);
+int lept_msgpack_decode(lept_source& in, lept_value& v);
+void lept_cbor_encode(const lept_value& v, lept_sink& out);
+int lept_cbor_decode(lept_source& in, lept_value& v);
@@ -0,0 +1,438 @@
+#include "leptjson_patch.h"
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* A parsed JSON Pointer; array indices stay as text until resolved. */
+typedef std::vector<std::string> lept_pointer;
+
+enum {
+	LEPT_UNDO_ERASE,	/* remove what is at path */
+	LEPT_UNDO_INSERT,	/* put value (or the last erased value) back at path */
+	LEPT_UNDO_SET		/* swap value back into path */
+};
+
+struct lept_undo {
+	int op;
+	lept_pointer path;
+	lept_value value;
+	bool carry;			/* LEPT_UNDO_INSERT of a moved value */
+};
+
+static int parse_pointer(const lept_value& v, lept_pointer& out) {
+	if (v.get_type() != lept_type::string)
+		return LEPT_PATCH_INVALID_OPERATION;
+	const std::string& s = v.get_string();
+	out.clear();
+	if (s.empty())
+		return LEPT_PATCH_OK;
+	if (s[0] != '/')
+		return LEPT_PATCH_INVALID_POINTER;
+	for (size_t i = 1; ; i++) {
+		std::string token;
+		for (; i < s.size() && s[i] != '/'; i++) {
+			if (s[i] != '~')
+				token.push_back(s[i]);
+			else if (i + 1 < s.size() && (s[i + 1] == '0' || s[i + 1] == '1'))
+				token.push_back(s[++i] == '0' ? '~' : '/');
+			else
+				return LEPT_PATCH_INVALID_POINTER;
+		}
+		out.push_back(std::move(token));
+		if (i >= s.size())
+			return LEPT_PATCH_OK;
+	}
+}
+
+/* Array index: "0" or no leading zeros; "-" (one past the end) only if allowed. */
+static bool parse_index(const std::string& t, size_t size, bool end_ok, size_t& index) {
+	if (t == "-") {
+		index = size;
+		return end_ok;
+	}
+	if (t.empty() || t.size() > 18 || (t[0] == '0' && t.size() > 1))
+		return false;
+	index = 0;
+	for (char c : t) {
+		if (c < '0' || c > '9')
+			return false;
+		index = index * 10 + (size_t)(c - '0');
+	}
+	return end_ok ? index <= size : index < size;
+}
+
+/* The value at path[0, n). */
+static lept_value* walk(lept_value& doc, const lept_pointer& path, size_t n) {
+	lept_value* v = &doc;
+	for (size_t i = 0; i < n; i++) {
+		if (v->get_type() == lept_type::object) {
+			auto& obj = v->get_object();
+			auto it = obj.find(path[i]);
+			if (it == obj.end())
+				return nullptr;
+			v = &it->second;
+		}
+		else if (v->get_type() == lept_type::array) {
+			size_t index;
+			if (!parse_index(path[i], v->get_array_size(), false, index))
+				return nullptr;
+			v = &v->get_array_element(index);
+		}
+		else
+			return nullptr;
+	}
+	return v;
+}
+
+class lept_patcher
+{
+public:
+	explicit lept_patcher(lept_value& doc) : doc(doc) {}
+
+	int apply(const lept_value& op) {
+		if (op.get_type() != lept_type::object || !op.contains_key("op") || !op.contains_key("path")
+			|| op["op"].get_type() != lept_type::string)
+			return LEPT_PATCH_INVALID_OPERATION;
+		const std::string& name = op["op"].get_string();
+		lept_pointer path, from;
+		int ret;
+		if ((ret = parse_pointer(op["path"], path)) != LEPT_PATCH_OK)
+			return ret;
+
+		if (name == "add" || name == "replace" || name == "test") {
+			if (!op.contains_key("value"))
+				return LEPT_PATCH_INVALID_OPERATION;
+			if (name == "add")
+				return add(path, lept_value(op["value"]));
+			if (name == "replace")
+				return replace(path, lept_value(op["value"]));
+			lept_value* v = walk(doc, path, path.size());
+			if (!v)
+				return LEPT_PATCH_PATH_NOT_FOUND;
+			return *v == op["value"] ? LEPT_PATCH_OK : LEPT_PATCH_TEST_FAILED;
+		}
+		if (name == "remove") {
+			lept_value out;
+			return remove(path, out, false);
+		}
+		if (name == "move" || name == "copy") {
+			if (!op.contains_key("from"))
+				return LEPT_PATCH_INVALID_OPERATION;
+			if ((ret = parse_pointer(op["from"], from)) != LEPT_PATCH_OK)
+				return ret;
+			if (name == "copy") {
+				lept_value* v = walk(doc, from, from.size());
+				if (!v)
+					return LEPT_PATCH_PATH_NOT_FOUND;
+				return add(path, lept_value(*v));
+			}
+			if (path == from)
+				return walk(doc, from, from.size()) ? LEPT_PATCH_OK : LEPT_PATCH_PATH_NOT_FOUND;
+			/* a value cannot be moved into its own subtree */
+			if (from.size() < path.size() && std::equal(from.begin(), from.end(), path.begin()))
+				return LEPT_PATCH_INVALID_OPERATION;
+			lept_value v;
+			if ((ret = remove(from, v, true)) != LEPT_PATCH_OK)
+				return ret;
+			if ((ret = add(path, std::move(v))) != LEPT_PATCH_OK) {
+				/* add() left v alone, so the rollback must restore it */
+				log.back().value = std::move(v);
+				log.back().carry = false;
+			}
+			return ret;
+		}
+		return LEPT_PATCH_INVALID_OPERATION;
+	}
+
+	void rollback() {
+		lept_value carry;
+		while (!log.empty()) {
+			lept_undo& u = log.back();
+			if (u.op == LEPT_UNDO_INSERT)
+				insert(u.path, u.carry ? std::move(carry) : std::move(u.value));
+			else {
+				lept_value* v = walk(doc, u.path, u.path.size());
+				assert(v);
+				if (u.op == LEPT_UNDO_SET)
+					std::swap(*v, u.value);
+				carry = std::move(u.op == LEPT_UNDO_SET ? u.value : *v);
+				if (u.op == LEPT_UNDO_ERASE)
+					erase(u.path);
+			}
+			log.pop_back();
+		}
+	}
+
+private:
+	lept_value& doc;
+	std::vector<lept_undo> log;
+
+	void record(int op, const lept_pointer& path, lept_value&& value = lept_value(), bool carry = false) {
+		log.push_back(lept_undo{ op, path, std::move(value), carry });
+	}
+
+	/* Undo helpers; the path is known to be valid. */
+	void insert(const lept_pointer& path, lept_value&& value) {
+		lept_value* parent = walk(doc, path, path.size() - 1);
+		assert(parent);
+		if (parent->get_type() == lept_type::object)
+			parent->get_object().emplace(path.back(), std::move(value));
+		else {
+			auto& arr = parent->get<lept_value::array_t>();
+			arr.insert(arr.begin() + std::stoll(path.back()), std::move(value));
+		}
+	}
+
+	void erase(const lept_pointer& path) {
+		lept_value* parent = walk(doc, path, path.size() - 1);
+		assert(parent);
+		if (parent->get_type() == lept_type::object)
+			parent->get_object().erase(path.back());
+		else {
+			auto& arr = parent->get<lept_value::array_t>();
+			arr.erase(arr.begin() + std::stoll(path.back()));
+		}
+	}
+
+	int add(const lept_pointer& path, lept_value&& value) {
+		if (path.empty()) {
+			std::swap(doc, value);
+			record(LEPT_UNDO_SET, path, std::move(value));
+			return LEPT_PATCH_OK;
+		}
+		lept_value* parent = walk(doc, path, path.size() - 1);
+		if (!parent)
+			return LEPT_PATCH_PATH_NOT_FOUND;
+		if (parent->get_type() == lept_type::object) {
+			auto& obj = parent->get_object();
+			auto it = obj.find(path.back());
+			if (it != obj.end()) {
+				std::swap(it->second, value);
+				record(LEPT_UNDO_SET, path, std::move(value));
+			}
+			else {
+				obj.emplace(path.back(), std::move(value));
+				record(LEPT_UNDO_ERASE, path);
+			}
+			return LEPT_PATCH_OK;
+		}
+		if (parent->get_type() == lept_type::array) {
+			auto& arr = parent->get<lept_value::array_t>();
+			size_t index;
+			if (!parse_index(path.back(), arr.size(), true, index))
+				return LEPT_PATCH_PATH_NOT_FOUND;
+			arr.insert(arr.begin() + index, std::move(value));
+			lept_pointer at(path);
+			at.back() = std::to_string(index);
+			record(LEPT_UNDO_ERASE, at);
+			return LEPT_PATCH_OK;
+		}
+		return LEPT_PATCH_PATH_NOT_FOUND;
+	}
+
+	/* With moved set the removed value is handed to a following add, so the
+	 * undo entry takes it back from whatever that add's undo releases. */
+	int remove(const lept_pointer& path, lept_value& out, bool moved) {
+		if (path.empty())
+			return LEPT_PATCH_INVALID_OPERATION;
+		lept_value* parent = walk(doc, path, path.size() - 1);
+		if (!parent)
+			return LEPT_PATCH_PATH_NOT_FOUND;
+		if (parent->get_type() == lept_type::object) {
+			auto& obj = parent->get_object();
+			auto it = obj.find(path.back());
+			if (it == obj.end())
+				return LEPT_PATCH_PATH_NOT_FOUND;
+			out = std::move(it->second);
+			obj.erase(it);
+		}
+		else if (parent->get_type() == lept_type::array) {
+			auto& arr = parent->get<lept_value::array_t>();
+			size_t index;
+			if (!parse_index(path.back(), arr.size(), false, index))
+				return LEPT_PATCH_PATH_NOT_FOUND;
+			out = std::move(arr[index]);
+			arr.erase(arr.begin() + index);
+		}
+		else
+			return LEPT_PATCH_PATH_NOT_FOUND;
+		if (moved)
+			record(LEPT_UNDO_INSERT, path, lept_value(), true);
+		else
+			record(LEPT_UNDO_INSERT, path, std::move(out));
+		return LEPT_PATCH_OK;
+	}
+
+	int replace(const lept_pointer& path, lept_value&& value) {
+		lept_value* v = walk(doc, path, path.size());
+		if (!v)
+			return LEPT_PATCH_PATH_NOT_FOUND;
+		std::swap(*v, value);
+		record(LEPT_UNDO_SET, path, std::move(value));
+		return LEPT_PATCH_OK;
+	}
+};
+
+int lept_apply_patch(lept_value& doc, const lept_value& patch, size_t* failed) {
+	if (patch.get_type() != lept_type::array) {
+		if (failed)
+			*failed = 0;
+		return LEPT_PATCH_INVALID_OPERATION;
+	}
+	lept_patcher p(doc);
+	for (size_t i = 0; i < patch.get_array_size(); i++) {
+		int ret = p.apply(patch.get_array_element(i));
+		if (ret != LEPT_PATCH_OK) {
+			p.rollback();
+			if (failed)
+				*failed = i;
+			return ret;
+		}
+	}
+	return LEPT_PATCH_OK;
+}
+
+/**********************************  diff  **************************************/
+
+class lept_differ
+{
+public:
+	explicit lept_differ(lept_value::array_t& ops) : ops(ops) {}
+
+	void diff(const lept_value& a, const lept_value& b, const std::string& path) {
+		if (same(a, b))
+			return;
+		if (a.get_type() == lept_type::object && b.get_type() == lept_type::object)
+			diff_object(a.get_object(), b.get_object(), path);
+		else if (a.get_type() == lept_type::array && b.get_type() == lept_type::array)
+			diff_array(a.get<lept_value::array_t>(), b.get<lept_value::array_t>(), path);
+		else
+			emit("replace", path, &b);
+	}
+
+private:
+	lept_value::array_t& ops;
+	lept_hash_cache hash;
+
+	bool same(const lept_value& a, const lept_value& b) {
+		return hash(a) == hash(b) && a == b;
+	}
+
+	void emit(const char* op, const std::string& path, const lept_value* value) {
+		lept_value::object_t o;
+		o.emplace("op", lept_value(op));
+		o.emplace("path", lept_value(path));
+		if (value)
+			o.emplace("value", *value);
+		ops.emplace_back(std::move(o));
+	}
+
+	static std::string child(const std::string& path, const std::string& key) {
+		std::string p = path + "/";
+		for (char c : key) {
+			if (c == '~') p += "~0";
+			else if (c == '/') p += "~1";
+			else p.push_back(c);
+		}
+		return p;
+	}
+
+	static std::string child(const std::string& path, size_t index) {
+		return path + "/" + std::to_string(index);
+	}
+
+	void diff_object(const lept_value::object_t& a, const lept_value::object_t& b, const std::string& path) {
+		auto i = a.begin(), j = b.begin();
+		while (i != a.end() || j != b.end()) {
+			if (j == b.end() || (i != a.end() && i->first < j->first)) {
+				emit("remove", child(path, i->first), nullptr);
+				++i;
+			}
+			else if (i == a.end() || j->first < i->first) {
+				emit("add", child(path, j->first), &j->second);
+				++j;
+			}
+			else {
+				diff(i->second, j->second, child(path, i->first));
+				++i;
+				++j;
+			}
+		}
+	}
+
+	void diff_array(const lept_value::array_t& a, const lept_value::array_t& b, const std::string& path) {
+		size_t head = 0, n = a.size(), m = b.size();
+		while (head < n && head < m && same(a[head], b[head]))
+			head++;
+		while (n > head && m > head && same(a[n - 1], b[m - 1])) {
+			n--;
+			m--;
+		}
+		size_t rows = n - head, cols = m - head;
+		if (rows == 0 || cols == 0 || (rows + 1) * (cols + 1) > LEPT_DIFF_LCS_CELLS) {
+			diff_positional(a, b, head, n, m, path);
+			return;
+		}
+
+		/* lcs[i][j]: longest common subsequence of a[head+i, n) and b[head+j, m) */
+		std::vector<size_t> hb(cols);
+		for (size_t j = 0; j < cols; j++)
+			hb[j] = hash(b[head + j]);
+		std::vector<unsigned> lcs((rows + 1) * (cols + 1), 0);
+		auto at = [&](size_t i, size_t j) -> unsigned& { return lcs[i * (cols + 1) + j]; };
+		for (size_t i = rows; i-- > 0; ) {
+			size_t ha = hash(a[head + i]);
+			for (size_t j = cols; j-- > 0; ) {
+				if (ha == hb[j] && a[head + i] == b[head + j])
+					at(i, j) = at(i + 1, j + 1) + 1;
+				else
+					at(i, j) = std::max(at(i + 1, j), at(i, j + 1));
+			}
+		}
+
+		size_t i = 0, j = 0, index = head;
+		while (i < rows && j < cols) {
+			const lept_value& x = a[head + i];
+			const lept_value& y = b[head + j];
+			if (hash(x) == hb[j] && at(i, j) == at(i + 1, j + 1) + 1 && x == y) {
+				i++, j++, index++;
+			}
+			else if (at(i, j) == at(i + 1, j + 1)) {
+				/* dropping both costs nothing: change this element in place */
+				diff(x, y, child(path, index));
+				i++, j++, index++;
+			}
+			else if (at(i + 1, j) >= at(i, j + 1)) {
+				emit("remove", child(path, index), nullptr);
+				i++;
+			}
+			else {
+				emit("add", child(path, index), &y);
+				j++, index++;
+			}
+		}
+		for (; i < rows; i++)
+			emit("remove", child(path, index), nullptr);
+		for (; j < cols; j++, index++)
+			emit("add", child(path, index), &b[head + j]);
+	}
+
+	void diff_positional(const lept_value::array_t& a, const lept_value::array_t& b,
+		size_t head, size_t n, size_t m, const std::string& path) {
+		size_t common = std::min(n, m);
+		for (size_t i = head; i < common; i++)
+			diff(a[i], b[i], child(path, i));
+		for (size_t i = common; i < n; i++)
+			emit("remove", child(path, common), nullptr);
+		for (size_t j = common; j < m; j++)
+			emit("add", child(path, j), &b[j]);
+	}
+};
+
+lept_value lept_diff(const lept_value& a, const lept_value& b) {
+	lept_value::array_t ops;
+	lept_differ d(ops);
+	d.diff(a, b, "");
+	return lept_value(std::move(ops));
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+#include "leptjson.h"
+
+/* JSON Patch (RFC 6902) applied in place, and generated by diffing.
+ *
+ * Operations work directly on the document's object_t and array_t: values
+ * are moved between locations rather than copied, and only the values
+ * carried in the patch itself are copied in.  Each step records how to undo
+ * itself, so if any operation fails every earlier one is rolled back and doc
+ * is left exactly as it was.  failed, if given, receives the index of the
+ * operation that failed. */
+
+enum {
+	LEPT_PATCH_OK = 0,
+	LEPT_PATCH_INVALID_OPERATION,	/* not an object, unknown op, or a member missing */
+	LEPT_PATCH_INVALID_POINTER,		/* path or from is not a JSON Pointer */
+	LEPT_PATCH_PATH_NOT_FOUND,
+	LEPT_PATCH_TEST_FAILED
+};
+
+int lept_apply_patch(lept_value& doc, const lept_value& patch, size_t* failed = nullptr);
+
+/* A patch turning a into b.  Subtrees are compared by hash first, so equal
+ * parts are skipped after one hashing pass.  Objects are merged key by key.
+ * For arrays the common head and tail are trimmed, and the rest is aligned
+ * by a longest common subsequence of element hashes.  Elements replaced in
+ * place are diffed recursively.  Past LEPT_DIFF_LCS_CELLS the alignment
+ * falls back to comparing position by position. */
+#define LEPT_DIFF_LCS_CELLS (1 << 22)
+
+lept_value lept_diff(const lept_value& a, const lept_value& b);
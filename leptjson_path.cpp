@@ -0,0 +1,462 @@
+#include "leptjson_path.h"
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include "leptjson_reader.h"
+
+/**********************************  compiling  **************************************/
+
+class lept_path_compiler
+{
+public:
+	lept_path_compiler(std::string_view expr) : s(expr), p(0) {}
+
+	int compile(std::vector<lept_path_step>& steps);
+	size_t offset() const { return p; }
+
+private:
+	std::string_view s;
+	size_t p;
+
+	char cur() const { return p < s.size() ? s[p] : '\0'; }
+	void skip_space() { while (cur() == ' ') p++; }
+	bool name(std::string& out);
+	bool quoted(std::string& out);
+	bool index(size_t& out);
+	bool bracket(lept_path_step& st, bool filter_allowed);
+	bool filter(lept_path_step& st);
+	bool literal(lept_value& v);
+};
+
+static bool is_name_char(char c) {
+	unsigned char u = (unsigned char)c;
+	return (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') || (u >= '0' && u <= '9') ||
+		u == '_' || u == '-' || u == '$' || u >= 0x80;
+}
+
+bool lept_path_compiler::name(std::string& out) {
+	size_t start = p;
+	while (is_name_char(cur()))
+		p++;
+	out.assign(s.data() + start, p - start);
+	return p > start;
+}
+
+bool lept_path_compiler::quoted(std::string& out) {
+	char q = cur();
+	if (q != '\'' && q != '\"')
+		return false;
+	out.clear();
+	for (p++; cur() != q; p++) {
+		if (cur() == '\0')
+			return false;
+		if (cur() == '\\' && p + 1 < s.size())
+			p++;
+		out.push_back(cur());
+	}
+	p++;
+	return true;
+}
+
+bool lept_path_compiler::index(size_t& out) {
+	size_t start = p;
+	out = 0;
+	while (cur() >= '0' && cur() <= '9') {
+		size_t d = (size_t)(s[p] - '0');
+		if (out > ((size_t)-1 - d) / 10)
+			return false;
+		out = out * 10 + d;
+		p++;
+	}
+	return p > start;
+}
+
+/* after '[': a name, an index, '*' or a filter, then ']' */
+bool lept_path_compiler::bracket(lept_path_step& st, bool filter_allowed) {
+	skip_space();
+	if (cur() == '*') {
+		p++;
+		st.kind = lept_path_step::WILDCARD;
+	}
+	else if (cur() == '?' && filter_allowed) {
+		p++;
+		if (!filter(st))
+			return false;
+	}
+	else if (quoted(st.name))
+		st.kind = lept_path_step::MEMBER;
+	else if (index(st.index))
+		st.kind = lept_path_step::INDEX;
+	else
+		return false;
+	skip_space();
+	if (cur() != ']')
+		return false;
+	p++;
+	return true;
+}
+
+bool lept_path_compiler::literal(lept_value& v) {
+	std::string text;
+	if (quoted(text)) {
+		v.set_string(text);
+		return true;
+	}
+	size_t start = p;
+	while (cur() != '\0' && cur() != ' ' && cur() != ')')
+		p++;
+	/* true, false, null and JSON numbers read as JSON */
+	lept_value tmp;
+	if (p == start || tmp.parse(std::string(s.substr(start, p - start))) != LEPT_PARSE_OK)
+		return false;
+	lept_type t = tmp.get_type();
+	if (t == lept_type::string || t == lept_type::array || t == lept_type::object)
+		return false;
+	v = std::move(tmp);
+	return true;
+}
+
+/* after '?': (@ steps [op literal]) */
+bool lept_path_compiler::filter(lept_path_step& st) {
+	static const struct { const char* text; lept_path_step::op_t op; } ops[] = {
+		{ "==", lept_path_step::EQ }, { "!=", lept_path_step::NE },
+		{ "<=", lept_path_step::LE }, { ">=", lept_path_step::GE },
+		{ "<", lept_path_step::LT }, { ">", lept_path_step::GT }
+	};
+	st.kind = lept_path_step::FILTER;
+	skip_space();
+	if (cur() != '(')
+		return false;
+	p++;
+	skip_space();
+	if (cur() != '@')
+		return false;
+	p++;
+	for (;;) {
+		lept_path_step o;
+		if (cur() == '.') {
+			p++;
+			if (!name(o.name))
+				return false;
+			o.kind = lept_path_step::MEMBER;
+		}
+		else if (cur() == '[') {
+			p++;
+			if (!bracket(o, false) || o.kind == lept_path_step::WILDCARD)
+				return false;
+		}
+		else
+			break;
+		st.operand.push_back(std::move(o));
+	}
+	skip_space();
+	st.op = lept_path_step::EXISTS;
+	for (auto& o : ops) {
+		if (s.substr(p, strlen(o.text)) == o.text) {
+			p += strlen(o.text);
+			st.op = o.op;
+			break;
+		}
+	}
+	if (st.op != lept_path_step::EXISTS) {
+		skip_space();
+		if (!literal(st.literal))
+			return false;
+		skip_space();
+	}
+	if (cur() != ')')
+		return false;
+	p++;
+	return true;
+}
+
+int lept_path_compiler::compile(std::vector<lept_path_step>& steps) {
+	steps.clear();
+	skip_space();
+	if (cur() != '$')
+		return LEPT_PATH_INVALID;
+	p++;
+	while (p < s.size()) {
+		lept_path_step st;
+		if (cur() == '.') {
+			p++;
+			bool descend = cur() == '.';
+			if (descend)
+				p++;
+			if (cur() == '*') {
+				p++;
+				st.kind = lept_path_step::WILDCARD;
+			}
+			else if (descend && cur() == '[') {
+				p++;
+				if (!bracket(st, false) || (st.kind != lept_path_step::MEMBER && st.kind != lept_path_step::WILDCARD))
+					return LEPT_PATH_INVALID;
+			}
+			else if (name(st.name))
+				st.kind = lept_path_step::MEMBER;
+			else
+				return LEPT_PATH_INVALID;
+			if (descend)
+				st.kind = st.kind == lept_path_step::MEMBER ? lept_path_step::DESCEND_MEMBER : lept_path_step::DESCEND_WILDCARD;
+		}
+		else if (cur() == '[') {
+			p++;
+			if (!bracket(st, true))
+				return LEPT_PATH_INVALID;
+		}
+		else
+			return LEPT_PATH_INVALID;
+		steps.push_back(std::move(st));
+	}
+	return LEPT_PATH_OK;
+}
+
+int lept_path::compile(std::string_view expr, size_t* error) {
+	lept_path_compiler c(expr);
+	int ret = c.compile(steps);
+	if (ret != LEPT_PATH_OK)
+		steps.clear();
+	if (error)
+		*error = ret == LEPT_PATH_OK ? 0 : c.offset();
+	return ret;
+}
+
+/**********************************  evaluating  **************************************/
+
+static bool path_compare(const lept_value& a, const lept_path_step& st) {
+	const lept_value& b = st.literal;
+	int order;
+	bool numeric = (a.get_type() == lept_type::integer || a.get_type() == lept_type::number) &&
+		(b.get_type() == lept_type::integer || b.get_type() == lept_type::number);
+	if (numeric) {
+		double x = a.get_type() == lept_type::integer ? a.get_integer() : a.get_number();
+		double y = b.get_type() == lept_type::integer ? b.get_integer() : b.get_number();
+		order = x < y ? -1 : x > y ? 1 : 0;
+	}
+	else if (a.get_type() == lept_type::string && b.get_type() == lept_type::string)
+		order = a.get_string_view().compare(b.get_string_view());
+	else if (st.op == lept_path_step::EQ)
+		return a == b;
+	else if (st.op == lept_path_step::NE)
+		return a != b;
+	else
+		return false;	/* no ordering across types */
+	switch (st.op) {
+		case lept_path_step::EQ: return order == 0;
+		case lept_path_step::NE: return order != 0;
+		case lept_path_step::LT: return order < 0;
+		case lept_path_step::LE: return order <= 0;
+		case lept_path_step::GT: return order > 0;
+		case lept_path_step::GE: return order >= 0;
+		default: return true;
+	}
+}
+
+static bool path_test(const lept_path_step& st, const lept_value& v) {
+	const lept_value* p = &v;
+	for (auto& o : st.operand) {
+		if (o.kind == lept_path_step::MEMBER) {
+			if (p->get_type() != lept_type::object)
+				return false;
+			auto it = p->get_object().find(o.name);
+			if (it == p->get_object().end())
+				return false;
+			p = &it->second;
+		}
+		else {
+			if (p->get_type() != lept_type::array || o.index >= p->get_array_size())
+				return false;
+			p = &p->get_array_element(o.index);
+		}
+	}
+	return st.op == lept_path_step::EXISTS || path_compare(*p, st);
+}
+
+class lept_path_run
+{
+public:
+	lept_path_run(const std::vector<lept_path_step>& steps, std::function<void(const lept_value&)> emit)
+		: steps(steps), emit(std::move(emit)) {}
+
+	/* a value reached in each of states, the numbers of steps taken; kept
+	 * in descending order, without repeats */
+	void match(const lept_value& v, const std::vector<size_t>& states);
+	int walk(lept_reader& r, const std::vector<size_t>& states);
+
+private:
+	const std::vector<lept_path_step>& steps;
+	std::function<void(const lept_value&)> emit;
+
+	void advance(const std::vector<size_t>& states, const std::string_view* key, size_t index,
+		const lept_value* child, std::vector<size_t>& next) const;
+};
+
+/* Both modes take the same states from node to node, so a value reached
+ * by two routes, as $..a..b can, is selected once either way. */
+void lept_path_run::match(const lept_value& v, const std::vector<size_t>& states) {
+	if (states.empty())
+		return;
+	size_t s = states[0];
+	if (s == steps.size()) {
+		emit(v);
+		if (states.size() == 1)
+			return;
+	}
+	else if (states.size() == 1) {
+		/* only a .. step keeps more than one state; look the child up */
+		const lept_path_step& st = steps[s];
+		if (st.kind == lept_path_step::MEMBER) {
+			if (v.get_type() == lept_type::object) {
+				auto it = v.get_object().find(st.name);
+				if (it != v.get_object().end())
+					match(it->second, std::vector<size_t>(1, s + 1));
+			}
+			return;
+		}
+		if (st.kind == lept_path_step::INDEX) {
+			if (v.get_type() == lept_type::array && st.index < v.get_array_size())
+				match(v.get_array_element(st.index), std::vector<size_t>(1, s + 1));
+			return;
+		}
+	}
+	std::vector<size_t> next;
+	if (v.get_type() == lept_type::array) {
+		size_t i = 0;
+		for (auto& e : v.get<lept_value::array_t>()) {
+			advance(states, nullptr, i++, &e, next);
+			match(e, next);
+		}
+	}
+	else if (v.get_type() == lept_type::object) {
+		for (auto& item : v.get_object()) {
+			std::string_view key(item.first);
+			advance(states, &key, 0, &item.second, next);
+			match(item.second, next);
+		}
+	}
+}
+
+/* The states of a child, by key or index, from its parent's states; filters
+ * need the child built. */
+void lept_path_run::advance(const std::vector<size_t>& states, const std::string_view* key, size_t index,
+	const lept_value* child, std::vector<size_t>& next) const {
+	next.clear();
+	for (size_t s : states) {
+		if (s == steps.size())
+			continue;
+		const lept_path_step& st = steps[s];
+		switch (st.kind) {
+			case lept_path_step::MEMBER:
+				if (key && *key == st.name)
+					next.push_back(s + 1);
+				break;
+			case lept_path_step::INDEX:
+				if (!key && index == st.index)
+					next.push_back(s + 1);
+				break;
+			case lept_path_step::WILDCARD:
+				next.push_back(s + 1);
+				break;
+			case lept_path_step::DESCEND_MEMBER:
+				if (key && *key == st.name)
+					next.push_back(s + 1);
+				next.push_back(s);
+				break;
+			case lept_path_step::DESCEND_WILDCARD:
+				next.push_back(s + 1);
+				next.push_back(s);
+				break;
+			case lept_path_step::FILTER:
+				if (child && path_test(st, *child))
+					next.push_back(s + 1);
+				break;
+			default:
+				break;
+		}
+	}
+	std::sort(next.begin(), next.end(), std::greater<size_t>());
+	next.erase(std::unique(next.begin(), next.end()), next.end());
+}
+
+int lept_path_run::walk(lept_reader& r, const std::vector<size_t>& states) {
+	if (states.empty())
+		return r.skip_value();
+	/* a selected value is built and the rest of the query runs over the
+	 * tree; under a filter each child is built on its own to be tested */
+	bool build = false, filter = false;
+	for (size_t s : states) {
+		build |= s == steps.size();
+		filter |= s < steps.size() && steps[s].kind == lept_path_step::FILTER;
+	}
+	int ret;
+	if (build) {
+		lept_value v;
+		if ((ret = r.read_value(v)) != LEPT_PARSE_OK)
+			return ret;
+		match(v, states);
+		return LEPT_PARSE_OK;
+	}
+
+	lept_type t;
+	if ((ret = r.peek(t)) != LEPT_PARSE_OK)
+		return ret;
+	std::vector<size_t> next;
+	lept_value child;
+	bool more;
+	if (t == lept_type::array) {
+		if ((ret = r.begin_array()) != LEPT_PARSE_OK)
+			return ret;
+		for (size_t i = 0; (ret = r.next_element(more)) == LEPT_PARSE_OK && more; i++) {
+			if (filter) {
+				if ((ret = r.read_value(child)) != LEPT_PARSE_OK)
+					return ret;
+				advance(states, nullptr, i, &child, next);
+				match(child, next);
+			}
+			else {
+				advance(states, nullptr, i, nullptr, next);
+				if ((ret = walk(r, next)) != LEPT_PARSE_OK)
+					return ret;
+			}
+		}
+		return ret;
+	}
+	if (t == lept_type::object) {
+		if ((ret = r.begin_object()) != LEPT_PARSE_OK)
+			return ret;
+		std::string_view key;
+		while ((ret = r.next_key(key, more)) == LEPT_PARSE_OK && more) {
+			if (filter) {
+				/* key points into the reader, which read_value() may reuse */
+				std::string k(key);
+				std::string_view kv(k);
+				if ((ret = r.read_value(child)) != LEPT_PARSE_OK)
+					return ret;
+				advance(states, &kv, 0, &child, next);
+				match(child, next);
+			}
+			else {
+				advance(states, &key, 0, nullptr, next);
+				if ((ret = walk(r, next)) != LEPT_PARSE_OK)
+					return ret;
+			}
+		}
+		return ret;
+	}
+	return r.skip_value();
+}
+
+void lept_path::select(const lept_value& doc, std::vector<const lept_value*>& out) const {
+	lept_path_run run(steps, [&out](const lept_value& v) { out.push_back(&v); });
+	run.match(doc, std::vector<size_t>(1, 0));
+}
+
+int lept_path::select(std::string_view json, std::vector<lept_value>& out) const {
+	lept_path_run run(steps, [&out](const lept_value& v) { out.push_back(v); });
+	lept_reader r(json);
+	std::vector<size_t> states(1, 0);
+	int ret = run.walk(r, states);
+	if (ret == LEPT_PARSE_OK)
+		ret = r.finish();
+	return ret;
+}
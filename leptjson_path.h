@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "leptjson.h"
+
+/* Compiled JSONPath queries, for a subset of the syntax:
+ *
+ *	$				the root
+ *	.name ['name']	a member ("name" quoted the same way)
+ *	[3]				an array element
+ *	.* [*]			every member or element
+ *	..name ..*		a member, or everything, at any depth below
+ *	[?(@.x > 3)]	members or elements passing a test: a relative path of
+ *					.name and [n] steps, optionally compared with == != < <=
+ *					> >= against a number, string, true, false or null
+ *
+ *	lept_path p;
+ *	p.compile("$.items[?(@.qty > 3)].sku");
+ *	p.select(doc, hits);		(over a parsed document)
+ *	p.select(json, values);		(over text, with lept_reader)
+ *
+ * A plan is compiled once and may be used from many threads.  Over text,
+ * subtrees that no step can reach are skipped without being built; a value
+ * is materialized only when it is selected or a filter tests it, never the
+ * whole container a filter runs over.  A value is selected once however
+ * many routes reach it, and an outer match comes before the matches nested
+ * in it; members are visited in key order over a document (object_t is
+ * sorted) and in text order over text.  Numbers compare as doubles, and an
+ * integer outside int is a number in both modes. */
+
+enum {
+	LEPT_PATH_OK = 0,
+	LEPT_PATH_INVALID
+};
+
+struct lept_path_step
+{
+	enum kind_t { MEMBER, INDEX, WILDCARD, DESCEND_MEMBER, DESCEND_WILDCARD, FILTER };
+	enum op_t { EXISTS, EQ, NE, LT, LE, GT, GE };
+
+	kind_t kind;
+	std::string name;
+	size_t index = 0;
+	/* FILTER: the relative path, made of MEMBER and INDEX steps */
+	std::vector<lept_path_step> operand;
+	op_t op = EXISTS;
+	lept_value literal;
+};
+
+class lept_path
+{
+public:
+	/* error, if given, receives the offset where expr stopped making sense */
+	int compile(std::string_view expr, size_t* error = nullptr);
+
+	void select(const lept_value& doc, std::vector<const lept_value*>& out) const;
+	/* returns a LEPT_PARSE_* code; out keeps what was found before an error */
+	int select(std::string_view json, std::vector<lept_value>& out) const;
+	/* lept_value converts from these too, so pick the text overload */
+	int select(const char* json, std::vector<lept_value>& out) const { return select(std::string_view(json), out); }
+	int select(const std::string& json, std::vector<lept_value>& out) const { return select(std::string_view(json), out); }
+
+private:
+	std::vector<lept_path_step> steps;
+
+	friend class lept_path_run;
+};
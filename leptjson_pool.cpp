@@ -0,0 +1,93 @@
+#include "leptjson_pool.h"
+
+static const int LEPT_POOL_MIN_SHIFT = 4;	/* 16 bytes, room for the link */
+static const int LEPT_POOL_CLASSES = 13;	/* 16 bytes .. LEPT_POOL_MAX_BLOCK */
+
+static_assert((size_t)1 << (LEPT_POOL_MIN_SHIFT + LEPT_POOL_CLASSES - 1) == LEPT_POOL_MAX_BLOCK,
+	"size classes must end at LEPT_POOL_MAX_BLOCK");
+
+struct lept_pool_block {
+	lept_pool_block* next;
+};
+
+/* Trivially destructible, so it stays usable while other thread_local
+ * objects are destroyed; dead routes their frees to operator delete. */
+struct lept_pool_cache {
+	lept_pool_block* head[LEPT_POOL_CLASSES];
+	size_t bytes[LEPT_POOL_CLASSES];
+	bool registered;
+	bool dead;
+};
+
+static thread_local lept_pool_cache cache;
+
+struct lept_pool_reaper {
+	~lept_pool_reaper() {
+		lept_pool_trim();
+		cache.dead = true;
+	}
+};
+
+static int size_class(size_t n) {
+	if (n <= ((size_t)1 << LEPT_POOL_MIN_SHIFT))
+		return 0;
+	int bits = 0;
+	for (size_t m = (n - 1) >> LEPT_POOL_MIN_SHIFT; m; m >>= 1)
+		bits++;
+	return bits;
+}
+
+void* lept_pool_allocate(size_t n) {
+	if (n > LEPT_POOL_MAX_BLOCK || cache.dead)
+		return ::operator new(n);
+	int c = size_class(n);
+	lept_pool_block* b = cache.head[c];
+	if (b) {
+		cache.head[c] = b->next;
+		cache.bytes[c] -= (size_t)1 << (c + LEPT_POOL_MIN_SHIFT);
+		return b;
+	}
+	return ::operator new((size_t)1 << (c + LEPT_POOL_MIN_SHIFT));
+}
+
+void lept_pool_deallocate(void* p, size_t n) {
+	if (!p)
+		return;
+	if (n > LEPT_POOL_MAX_BLOCK || cache.dead) {
+		::operator delete(p);
+		return;
+	}
+	int c = size_class(n);
+	size_t size = (size_t)1 << (c + LEPT_POOL_MIN_SHIFT);
+	if (cache.bytes[c] + size > LEPT_POOL_MAX_CACHED) {
+		::operator delete(p);
+		return;
+	}
+	if (!cache.registered) {
+		/* constructed on first use, destroyed at thread exit */
+		static thread_local lept_pool_reaper reaper;
+		(void)reaper;
+		cache.registered = true;
+	}
+	lept_pool_block* b = static_cast<lept_pool_block*>(p);
+	b->next = cache.head[c];
+	cache.head[c] = b;
+	cache.bytes[c] += size;
+}
+
+void lept_pool_trim() {
+	for (int c = 0; c < LEPT_POOL_CLASSES; c++) {
+		while (lept_pool_block* b = cache.head[c]) {
+			cache.head[c] = b->next;
+			::operator delete(b);
+		}
+		cache.bytes[c] = 0;
+	}
+}
+
+size_t lept_pool_cached() {
+	size_t total = 0;
+	for (int c = 0; c < LEPT_POOL_CLASSES; c++)
+		total += cache.bytes[c];
+	return total;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <new>
+
+/* Thread-local recycling of small allocations.  Freed blocks are kept on a
+ * per-thread free list for each power-of-two size class up to
+ * LEPT_POOL_MAX_BLOCK bytes, and handed out again before asking malloc.
+ * Up to LEPT_POOL_MAX_CACHED bytes are kept per class; the rest, and larger
+ * blocks, go straight back to operator delete.  A block may be freed on any
+ * thread.  A thread's cache is released when the thread exits, or earlier
+ * through lept_pool_trim(). */
+#define LEPT_POOL_MAX_BLOCK (64 * 1024)
+#define LEPT_POOL_MAX_CACHED (1024 * 1024)
+
+void* lept_pool_allocate(size_t n);
+void lept_pool_deallocate(void* p, size_t n);
+void lept_pool_trim();
+/* bytes held on this thread's free lists */
+size_t lept_pool_cached();
+
+template<typename T>
+struct lept_pool_allocator
+{
+	using value_type = T;
+
+	lept_pool_allocator() noexcept {}
+	template<typename U>
+	lept_pool_allocator(const lept_pool_allocator<U>&) noexcept {}
+
+	T* allocate(size_t n) { return static_cast<T*>(lept_pool_allocate(n * sizeof(T))); }
+	void deallocate(T* p, size_t n) noexcept { lept_pool_deallocate(p, n * sizeof(T)); }
+
+	template<typename U>
+	bool operator==(const lept_pool_allocator<U>&) const noexcept { return true; }
+	template<typename U>
+	bool operator!=(const lept_pool_allocator<U>&) const noexcept { return false; }
+};
@@ -0,0 +1,422 @@
+#include "leptjson_reader.h"
+#include <assert.h>
+#include <string.h>
+#include <utility>
+#include "leptjson_scan.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+void lept_reader::skip_whitespace() {
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+		p++;
+}
+
+int lept_reader::peek(lept_type& type) {
+	skip_whitespace();
+	switch (cur()) {
+		case 'n': type = lept_type::null; return LEPT_PARSE_OK;
+		case 't':
+		case 'f': type = lept_type::boolean; return LEPT_PARSE_OK;
+		case '\"': type = lept_type::string; return LEPT_PARSE_OK;
+		case '[': type = lept_type::array; return LEPT_PARSE_OK;
+		case '{': type = lept_type::object; return LEPT_PARSE_OK;
+		case '\0':
+			if (p == end)
+				return LEPT_PARSE_EXPECT_VALUE;
+			return LEPT_PARSE_INVALID_VALUE;
+		default:
+		{
+			const char* save = p;
+			const char* stop;
+			bool is_integer;
+			int ret = scan_number(stop, is_integer);
+			p = save;
+			if (ret != LEPT_PARSE_OK)
+				return ret;
+			type = is_integer ? lept_type::integer : lept_type::number;
+			return LEPT_PARSE_OK;
+		}
+	}
+}
+
+int lept_reader::expect_literal(const char* literal, size_t len) {
+	if ((size_t)(end - p) < len || memcmp(p, literal, len) != 0)
+		return LEPT_PARSE_INVALID_VALUE;
+	p += len;
+	return LEPT_PARSE_OK;
+}
+
+int lept_reader::read_null() {
+	skip_whitespace();
+	first = false;
+	if (p == end)
+		return LEPT_PARSE_EXPECT_VALUE;
+	if (*p != 'n')
+		return LEPT_PARSE_TYPE_MISMATCH;
+	return expect_literal("null", 4);
+}
+
+int lept_reader::read_boolean(bool& b) {
+	skip_whitespace();
+	first = false;
+	if (p == end)
+		return LEPT_PARSE_EXPECT_VALUE;
+	if (*p == 't') {
+		b = true;
+		return expect_literal("true", 4);
+	}
+	if (*p == 'f') {
+		b = false;
+		return expect_literal("false", 5);
+	}
+	return LEPT_PARSE_TYPE_MISMATCH;
+}
+
+/* Validates the number at p and leaves p on its first character. */
+int lept_reader::scan_number(const char*& stop, bool& is_integer) {
+	return lept_scan_number(p, end, stop, is_integer);
+}
+
+static bool is_number_start(char ch) {
+	return ch == '-' || ISDIGIT(ch);
+}
+
+int lept_reader::read_integer(long long& i) {
+	const char* stop;
+	bool is_integer;
+	int ret;
+	skip_whitespace();
+	first = false;
+	if (p == end)
+		return LEPT_PARSE_EXPECT_VALUE;
+	if (!is_number_start(*p))
+		return LEPT_PARSE_TYPE_MISMATCH;
+	if ((ret = scan_number(stop, is_integer)) != LEPT_PARSE_OK)
+		return ret;
+	if (!is_integer)
+		return LEPT_PARSE_TYPE_MISMATCH;
+
+	if (lept_number_too_big(p, stop, true))
+		return LEPT_PARSE_NUMBER_TOO_BIG;
+	i = lept_strtoll(p, (size_t)(stop - p));
+	p = stop;
+	return LEPT_PARSE_OK;
+}
+
+int lept_reader::read_number(double& d) {
+	const char* stop;
+	bool is_integer;
+	int ret;
+	skip_whitespace();
+	first = false;
+	if (p == end)
+		return LEPT_PARSE_EXPECT_VALUE;
+	if (!is_number_start(*p))
+		return LEPT_PARSE_TYPE_MISMATCH;
+	if ((ret = scan_number(stop, is_integer)) != LEPT_PARSE_OK)
+		return ret;
+	if (lept_number_too_big(p, stop, is_integer))
+		return LEPT_PARSE_NUMBER_TOO_BIG;
+	d = lept_strtod(p, (size_t)(stop - p));
+	p = stop;
+	return LEPT_PARSE_OK;
+}
+
+/* Scans the string at p.  With out, the decoded text is stored there; with
+ * view, it is returned as a view of the input when free of escapes and of
+ * the scratch buffer otherwise; with neither, it is only validated. */
+int lept_reader::scan_string(std::string* out, std::string_view* view) {
+	assert(cur() == '\"');
+	const char* start = ++p;
+#ifdef __SSE2__
+	/* step over plain characters 16 at a time */
+	const __m128i quote = _mm_set1_epi8('\"'), backslash = _mm_set1_epi8('\\'), control = _mm_set1_epi8(0x1F);
+	for (; end - p >= 16; p += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)p);
+		__m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, backslash)),
+			_mm_cmpeq_epi8(_mm_max_epu8(x, control), control));
+		int mask = _mm_movemask_epi8(special);
+		if (mask) {
+			p += __builtin_ctz(mask);
+			break;
+		}
+	}
+#endif
+	while (p < end) {
+		unsigned char ch = (unsigned char)*p;
+		if (ch == '\"') {
+			if (out)
+				out->assign(start, p);
+			if (view)
+				*view = std::string_view(start, (size_t)(p - start));
+			p++;
+			return LEPT_PARSE_OK;
+		}
+		if (ch == '\\')
+			break;
+		if (ch < 0x20)
+			return LEPT_PARSE_INVALID_STRING_CHAR;
+		p++;
+	}
+	if (p == end)
+		return LEPT_PARSE_MISS_QUOTATION_MARK;
+
+	std::string* dst = out ? out : (view ? &scratch : nullptr);
+	if (dst)
+		dst->assign(start, p);
+	while (p < end) {
+		char ch = *p++;
+		if (ch == '\"') {
+			if (view)
+				*view = *dst;
+			return LEPT_PARSE_OK;
+		}
+		if ((unsigned char)ch < 0x20)
+			return LEPT_PARSE_INVALID_STRING_CHAR;
+		if (ch != '\\') {
+			if (dst)
+				dst->push_back(ch);
+			continue;
+		}
+		int ret = lept_unescape(p, end, dst);
+		if (ret != LEPT_PARSE_OK)
+			return ret;
+	}
+	return LEPT_PARSE_MISS_QUOTATION_MARK;
+}
+
+int lept_reader::read_string(std::string& s) {
+	skip_whitespace();
+	first = false;
+	if (p == end)
+		return LEPT_PARSE_EXPECT_VALUE;
+	if (*p != '\"')
+		return LEPT_PARSE_TYPE_MISMATCH;
+	return scan_string(&s, nullptr);
+}
+
+int lept_reader::begin_array() {
+	skip_whitespace();
+	if (p == end)
+		return LEPT_PARSE_EXPECT_VALUE;
+	if (*p != '[')
+		return LEPT_PARSE_TYPE_MISMATCH;
+	p++;
+	first = true;
+	return LEPT_PARSE_OK;
+}
+
+int lept_reader::next_element(bool& more) {
+	skip_whitespace();
+	if (first) {
+		first = false;
+		more = cur() != ']';
+		if (!more)
+			p++;
+		return LEPT_PARSE_OK;
+	}
+	if (cur() == ',') {
+		p++;
+		more = true;
+		return LEPT_PARSE_OK;
+	}
+	if (cur() == ']') {
+		p++;
+		more = false;
+		return LEPT_PARSE_OK;
+	}
+	return LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+}
+
+int lept_reader::begin_object() {
+	skip_whitespace();
+	if (p == end)
+		return LEPT_PARSE_EXPECT_VALUE;
+	if (*p != '{')
+		return LEPT_PARSE_TYPE_MISMATCH;
+	p++;
+	first = true;
+	return LEPT_PARSE_OK;
+}
+
+int lept_reader::next_member(std::string_view* key, bool& more) {
+	int ret;
+	skip_whitespace();
+	if (first) {
+		first = false;
+		if (cur() == '}') {
+			p++;
+			more = false;
+			return LEPT_PARSE_OK;
+		}
+	}
+	else if (cur() == '}') {
+		p++;
+		more = false;
+		return LEPT_PARSE_OK;
+	}
+	else if (cur() == ',') {
+		p++;
+		skip_whitespace();
+	}
+	else
+		return LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+
+	if (cur() != '\"')
+		return LEPT_PARSE_MISS_KEY;
+	if ((ret = scan_string(nullptr, key)) != LEPT_PARSE_OK)
+		return ret;
+	skip_whitespace();
+	if (cur() != ':')
+		return LEPT_PARSE_MISS_COLON;
+	p++;
+	more = true;
+	return LEPT_PARSE_OK;
+}
+
+int lept_reader::next_key(std::string_view& key, bool& more) {
+	return next_member(&key, more);
+}
+
+int lept_reader::skip_value() {
+	return skip_value(0);
+}
+
+int lept_reader::skip_value(int depth) {
+	const char* stop;
+	bool is_integer, more;
+	int ret;
+	skip_whitespace();
+	first = false;
+	switch (cur()) {
+		case 'n': return expect_literal("null", 4);
+		case 't': return expect_literal("true", 4);
+		case 'f': return expect_literal("false", 5);
+		case '\"': return scan_string(nullptr, nullptr);
+		case '[':
+			if (depth >= LEPT_PARSE_MAX_DEPTH)
+				return LEPT_PARSE_TOO_DEEP;
+			p++;
+			first = true;
+			while ((ret = next_element(more)) == LEPT_PARSE_OK && more)
+				if ((ret = skip_value(depth + 1)) != LEPT_PARSE_OK)
+					return ret;
+			return ret;
+		case '{':
+			if (depth >= LEPT_PARSE_MAX_DEPTH)
+				return LEPT_PARSE_TOO_DEEP;
+			p++;
+			first = true;
+			while ((ret = next_member(nullptr, more)) == LEPT_PARSE_OK && more)
+				if ((ret = skip_value(depth + 1)) != LEPT_PARSE_OK)
+					return ret;
+			return ret;
+		case '\0':
+			if (p == end)
+				return LEPT_PARSE_EXPECT_VALUE;
+			return LEPT_PARSE_INVALID_VALUE;
+		default:
+			if ((ret = scan_number(stop, is_integer)) != LEPT_PARSE_OK)
+				return ret;
+			if (lept_number_too_big(p, stop, is_integer))
+				return LEPT_PARSE_NUMBER_TOO_BIG;
+			p = stop;
+			return LEPT_PARSE_OK;
+	}
+}
+
+int lept_validate(std::string_view json, size_t* offset) {
+	lept_reader r(json);
+	int ret = r.skip_value();
+	if (ret == LEPT_PARSE_OK)
+		ret = r.finish();
+	if (offset)
+		*offset = r.offset();
+	return ret;
+}
+
+int lept_reader::read_value(lept_value& v) {
+	return read_value(v, 0);
+}
+
+int lept_reader::read_value(lept_value& v, int depth) {
+	lept_type type;
+	bool more;
+	int ret;
+	if ((ret = peek(type)) != LEPT_PARSE_OK)
+		return ret;
+	switch (type) {
+		case lept_type::null:
+			if ((ret = read_null()) == LEPT_PARSE_OK)
+				v.set_null();
+			return ret;
+		case lept_type::boolean:
+		{
+			bool b;
+			if ((ret = read_boolean(b)) == LEPT_PARSE_OK)
+				v.set_boolean(b);
+			return ret;
+		}
+		case lept_type::integer:
+		case lept_type::number:
+		{
+			/* stored as parse() stores it */
+			const char* stop;
+			bool is_integer;
+			scan_number(stop, is_integer);
+			if (lept_number_too_big(p, stop, is_integer))
+				return LEPT_PARSE_NUMBER_TOO_BIG;
+			lept_set_number(v, p, stop, is_integer);
+			p = stop;
+			first = false;
+			return LEPT_PARSE_OK;
+		}
+		case lept_type::string:
+		{
+			std::string s;
+			if ((ret = read_string(s)) == LEPT_PARSE_OK)
+				v.set_string(std::move(s));
+			return ret;
+		}
+		case lept_type::array:
+		{
+			lept_value::array_t arr;
+			if (depth >= LEPT_PARSE_MAX_DEPTH)
+				return LEPT_PARSE_TOO_DEEP;
+			begin_array();
+			while ((ret = next_element(more)) == LEPT_PARSE_OK && more) {
+				arr.emplace_back();
+				if ((ret = read_value(arr.back(), depth + 1)) != LEPT_PARSE_OK)
+					return ret;
+			}
+			if (ret == LEPT_PARSE_OK)
+				v.set_array(std::move(arr));
+			return ret;
+		}
+		case lept_type::object:
+		{
+			lept_value::object_t obj;
+			std::string_view key;
+			if (depth >= LEPT_PARSE_MAX_DEPTH)
+				return LEPT_PARSE_TOO_DEEP;
+			begin_object();
+			while ((ret = next_key(key, more)) == LEPT_PARSE_OK && more) {
+				lept_value e;
+				std::string k(key);
+				if ((ret = read_value(e, depth + 1)) != LEPT_PARSE_OK)
+					return ret;
+				obj.emplace(std::move(k), std::move(e));
+			}
+			if (ret == LEPT_PARSE_OK)
+				v.set_object(std::move(obj));
+			return ret;
+		}
+	}
+	return LEPT_PARSE_INVALID_VALUE;
+}
+
+int lept_reader::finish() {
+	skip_whitespace();
+	return p == end ? LEPT_PARSE_OK : LEPT_PARSE_ROOT_NOT_SINGULAR;
+}
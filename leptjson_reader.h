@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <string_view>
+#include "leptjson.h"
+
+/* Pull parser over a caller-owned buffer.  Values are consumed one at a time
+ * without building a lept_value tree; every call returns a LEPT_PARSE_* code
+ * and offset() reports where scanning stopped.
+ *
+ * Containers are walked with begin_array()/next_element() and
+ * begin_object()/next_key():
+ *
+ *	r.begin_array();
+ *	while ((ret = r.next_element(more)) == LEPT_PARSE_OK && more)
+ *		r.read_integer(i);
+ */
+class lept_reader
+{
+public:
+	explicit lept_reader(std::string_view json)
+		: begin(json.data()), p(json.data()), end(json.data() + json.size()), first(false) {}
+
+	size_t offset() const { return (size_t)(p - begin); }
+
+	/* Type of the next value without consuming it. */
+	int peek(lept_type& type);
+
+	int read_null();
+	int read_boolean(bool& b);
+	int read_integer(long long& i);
+	int read_number(double& d);		/* integers are accepted too */
+	int read_string(std::string& s);
+	/* Builds a lept_value for the next value and its subtree. */
+	int read_value(lept_value& v);
+	/* Checks and steps over the next value without storing or allocating
+	 * anything, applying the same rules as lept_value::parse(). */
+	int skip_value();
+	/* the same, for a value already depth containers deep */
+	int skip_value(int depth);
+
+	int begin_array();
+	int next_element(bool& more);
+	int begin_object();
+	/* key points into the input, or into an internal buffer if it had escapes;
+	 * it stays valid until the next call. */
+	int next_key(std::string_view& key, bool& more);
+
+	/* Only whitespace may follow the last value. */
+	int finish();
+
+private:
+	const char* begin;
+	const char* p;
+	const char* end;
+	bool first;
+	std::string scratch;
+
+	void skip_whitespace();
+	char cur() const { return p < end ? *p : '\0'; }
+	int expect_literal(const char* literal, size_t len);
+	int scan_number(const char*& stop, bool& is_integer);
+	int scan_string(std::string* out, std::string_view* view);
+	int next_member(std::string_view* key, bool& more);
+	int read_value(lept_value& v, int depth);
+};
+
+/* Whether json holds exactly one value that lept_value::parse() would
+ * accept, without building it.  Returns the LEPT_PARSE_* code; offset, if
+ * given, receives where checking stopped. */
+int lept_validate(std::string_view json, size_t* offset = nullptr);
@@ -0,0 +1,375 @@
+#pragma once
+
+#include <string.h>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "leptjson.h"
+#include "leptjson_reader.h"
+#include "leptjson_writer.h"
+
+/* Compile-time binding between JSON and plain structs.
+ *
+ *	struct point { int x; int y; std::optional<std::string> label; };
+ *	LEPT_REFLECT(point, x, y, label)
+ *
+ *	point pt;
+ *	int ret = lept_read(json, pt);
+ *	lept_write(pt, sink);
+ *
+ * LEPT_REFLECT goes at namespace scope next to the struct.  Reading drives
+ * lept_reader straight into the members with no lept_value in between: keys
+ * are matched by trying the member after the last one seen, then by
+ * dispatching on key length and first character, both fixed at compile time
+ * for each member, so a name is compared only when they agree.  Unknown keys
+ * are skipped.  Absent fields keep
+ * their previous value.
+ *
+ * Writing goes through lept_writer without building lept_value objects.
+ * Each key is emitted as a single literal, quotes and colon included, that
+ * the macro assembles at compile time; an empty optional is written as null.
+ *
+ * Supported members: bool, integral and floating types, std::string,
+ * std::vector, std::optional (null or absent), std::map with string keys,
+ * lept_value and other reflected structs. */
+
+template<typename C, typename M>
+struct lept_field
+{
+	const char* key;	/* "\"name\":" */
+	size_t len;		/* of the bare name */
+	M C::* member;
+
+	bool match(std::string_view k) const
+	{
+		return k.size() == len && memcmp(k.data(), key + 1, len) == 0;
+	}
+};
+
+#define LEPT_REFLECT_FIELD(type, f) lept_field<type, decltype(type::f)>{ "\"" #f "\":", sizeof(#f) - 1, &type::f }
+
+#define LEPT_REFLECT(type, ...) \
+	constexpr inline auto lept_reflect_fields(const type*) \
+	{ \
+		return std::make_tuple(LEPT_FOR_EACH(LEPT_REFLECT_FIELD, type, __VA_ARGS__)); \
+	}
+
+#define LEPT_EXPAND(x) x
+#define LEPT_FE_1(m, t, x) m(t, x)
+#define LEPT_FE_2(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_1(m, t, __VA_ARGS__))
+#define LEPT_FE_3(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_2(m, t, __VA_ARGS__))
+#define LEPT_FE_4(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_3(m, t, __VA_ARGS__))
+#define LEPT_FE_5(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_4(m, t, __VA_ARGS__))
+#define LEPT_FE_6(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_5(m, t, __VA_ARGS__))
+#define LEPT_FE_7(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_6(m, t, __VA_ARGS__))
+#define LEPT_FE_8(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_7(m, t, __VA_ARGS__))
+#define LEPT_FE_9(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_8(m, t, __VA_ARGS__))
+#define LEPT_FE_10(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_9(m, t, __VA_ARGS__))
+#define LEPT_FE_11(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_10(m, t, __VA_ARGS__))
+#define LEPT_FE_12(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_11(m, t, __VA_ARGS__))
+#define LEPT_FE_13(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_12(m, t, __VA_ARGS__))
+#define LEPT_FE_14(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_13(m, t, __VA_ARGS__))
+#define LEPT_FE_15(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_14(m, t, __VA_ARGS__))
+#define LEPT_FE_16(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_15(m, t, __VA_ARGS__))
+#define LEPT_FE_17(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_16(m, t, __VA_ARGS__))
+#define LEPT_FE_18(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_17(m, t, __VA_ARGS__))
+#define LEPT_FE_19(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_18(m, t, __VA_ARGS__))
+#define LEPT_FE_20(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_19(m, t, __VA_ARGS__))
+#define LEPT_FE_21(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_20(m, t, __VA_ARGS__))
+#define LEPT_FE_22(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_21(m, t, __VA_ARGS__))
+#define LEPT_FE_23(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_22(m, t, __VA_ARGS__))
+#define LEPT_FE_24(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_23(m, t, __VA_ARGS__))
+#define LEPT_FE_25(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_24(m, t, __VA_ARGS__))
+#define LEPT_FE_26(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_25(m, t, __VA_ARGS__))
+#define LEPT_FE_27(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_26(m, t, __VA_ARGS__))
+#define LEPT_FE_28(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_27(m, t, __VA_ARGS__))
+#define LEPT_FE_29(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_28(m, t, __VA_ARGS__))
+#define LEPT_FE_30(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_29(m, t, __VA_ARGS__))
+#define LEPT_FE_31(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_30(m, t, __VA_ARGS__))
+#define LEPT_FE_32(m, t, x, ...) m(t, x), LEPT_EXPAND(LEPT_FE_31(m, t, __VA_ARGS__))
+#define LEPT_FE_PICK(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, NAME, ...) NAME
+#define LEPT_FOR_EACH(m, t, ...) \
+	LEPT_EXPAND(LEPT_FE_PICK(__VA_ARGS__, LEPT_FE_32, LEPT_FE_31, LEPT_FE_30, LEPT_FE_29, LEPT_FE_28, LEPT_FE_27, LEPT_FE_26, LEPT_FE_25, LEPT_FE_24, LEPT_FE_23, LEPT_FE_22, LEPT_FE_21, LEPT_FE_20, LEPT_FE_19, LEPT_FE_18, LEPT_FE_17, LEPT_FE_16, LEPT_FE_15, LEPT_FE_14, LEPT_FE_13, LEPT_FE_12, LEPT_FE_11, LEPT_FE_10, LEPT_FE_9, LEPT_FE_8, LEPT_FE_7, LEPT_FE_6, LEPT_FE_5, LEPT_FE_4, LEPT_FE_3, LEPT_FE_2, LEPT_FE_1)(m, t, __VA_ARGS__))
+
+template<typename T, typename = void>
+struct lept_is_reflected : std::false_type {};
+
+template<typename T>
+struct lept_is_reflected<T, std::void_t<decltype(lept_reflect_fields((const T*)nullptr))>> : std::true_type {};
+
+/* lept_bind<T> knows how to read and write a T; unsupported types fail to compile. */
+template<typename T, typename Enable = void>
+struct lept_bind;
+
+template<typename T>
+int lept_read_into(lept_reader& r, T& out)
+{
+	return lept_bind<T>::read(r, out);
+}
+
+template<typename T>
+void lept_write_from(lept_writer& w, const T& v)
+{
+	lept_bind<T>::write(w, v);
+}
+
+template<>
+struct lept_bind<bool>
+{
+	static int read(lept_reader& r, bool& out) { return r.read_boolean(out); }
+	static void write(lept_writer& w, bool v) { w.boolean(v); }
+};
+
+template<typename T>
+struct lept_bind<T, std::enable_if_t<std::is_integral<T>::value && !std::is_same<T, bool>::value>>
+{
+	static int read(lept_reader& r, T& out)
+	{
+		long long i;
+		int ret;
+		if ((ret = r.read_integer(i)) != LEPT_PARSE_OK)
+			return ret;
+		if (std::is_unsigned<T>::value) {
+			if (i < 0 || (unsigned long long)i > (unsigned long long)std::numeric_limits<T>::max())
+				return LEPT_PARSE_NUMBER_TOO_BIG;
+		}
+		else if (i < (long long)std::numeric_limits<T>::min() || i > (long long)std::numeric_limits<T>::max())
+			return LEPT_PARSE_NUMBER_TOO_BIG;
+		out = (T)i;
+		return LEPT_PARSE_OK;
+	}
+
+	static void write(lept_writer& w, T v) { w.integer((long long)v); }
+};
+
+template<typename T>
+struct lept_bind<T, std::enable_if_t<std::is_floating_point<T>::value>>
+{
+	static int read(lept_reader& r, T& out)
+	{
+		double d;
+		int ret;
+		if ((ret = r.read_number(d)) == LEPT_PARSE_OK)
+			out = (T)d;
+		return ret;
+	}
+
+	static void write(lept_writer& w, T v) { w.number((double)v); }
+};
+
+template<>
+struct lept_bind<std::string>
+{
+	static int read(lept_reader& r, std::string& out) { return r.read_string(out); }
+	static void write(lept_writer& w, const std::string& v) { w.string(v); }
+};
+
+template<>
+struct lept_bind<lept_value>
+{
+	static int read(lept_reader& r, lept_value& out) { return r.read_value(out); }
+	static void write(lept_writer& w, const lept_value& v) { w.value(v); }
+};
+
+template<typename T, typename A>
+struct lept_bind<std::vector<T, A>>
+{
+	static int read(lept_reader& r, std::vector<T, A>& out)
+	{
+		bool more;
+		int ret;
+		if ((ret = r.begin_array()) != LEPT_PARSE_OK)
+			return ret;
+		out.clear();
+		while ((ret = r.next_element(more)) == LEPT_PARSE_OK && more) {
+			out.emplace_back();
+			if ((ret = lept_read_into(r, out.back())) != LEPT_PARSE_OK)
+				return ret;
+		}
+		return ret;
+	}
+
+	static void write(lept_writer& w, const std::vector<T, A>& v)
+	{
+		w.raw('[');
+		for (size_t i = 0; i < v.size(); i++) {
+			if (i) w.raw(',');
+			lept_write_from(w, v[i]);
+		}
+		w.raw(']');
+	}
+};
+
+template<typename T>
+struct lept_bind<std::optional<T>>
+{
+	static int read(lept_reader& r, std::optional<T>& out)
+	{
+		lept_type type;
+		int ret;
+		if ((ret = r.peek(type)) != LEPT_PARSE_OK)
+			return ret;
+		if (type == lept_type::null) {
+			out.reset();
+			return r.read_null();
+		}
+		return lept_read_into(r, out.emplace());
+	}
+
+	static void write(lept_writer& w, const std::optional<T>& v)
+	{
+		if (v)
+			lept_write_from(w, *v);
+		else
+			w.null();
+	}
+};
+
+template<typename T, typename C, typename A>
+struct lept_bind<std::map<std::string, T, C, A>>
+{
+	static int read(lept_reader& r, std::map<std::string, T, C, A>& out)
+	{
+		std::string_view key;
+		bool more;
+		int ret;
+		if ((ret = r.begin_object()) != LEPT_PARSE_OK)
+			return ret;
+		out.clear();
+		while ((ret = r.next_key(key, more)) == LEPT_PARSE_OK && more)
+			if ((ret = lept_read_into(r, out[std::string(key)])) != LEPT_PARSE_OK)
+				return ret;
+		return ret;
+	}
+
+	static void write(lept_writer& w, const std::map<std::string, T, C, A>& v)
+	{
+		bool first = true;
+		w.raw('{');
+		for (auto& item : v) {
+			if (!first) w.raw(',');
+			first = false;
+			w.string(item.first);
+			w.raw(':');
+			lept_write_from(w, item.second);
+		}
+		w.raw('}');
+	}
+};
+
+/* Key length and first character of member I of T, as one constant. */
+template<typename T, size_t I>
+inline constexpr unsigned lept_field_sig =
+	(unsigned)std::get<I>(lept_reflect_fields((const T*)nullptr)).len << 8 |
+	(unsigned char)std::get<I>(lept_reflect_fields((const T*)nullptr)).key[1];
+
+template<typename T, typename Fields, size_t... I>
+int lept_read_member(lept_reader& r, T& out, const Fields& fields, std::string_view key,
+	size_t& hint, std::index_sequence<I...>)
+{
+	int ret = LEPT_PARSE_OK;
+	auto try_field = [&](const auto& f, size_t i) {
+		if (!f.match(key))
+			return false;
+		ret = lept_read_into(r, out.*(f.member));
+		hint = i + 1;
+		return true;
+	};
+	/* members usually arrive in declaration order */
+	bool found = ((I == hint && try_field(std::get<I>(fields), I)) || ...);
+	if (!found && !key.empty()) {
+		unsigned sig = (unsigned)key.size() << 8 | (unsigned char)key[0];
+		found = ((sig == lept_field_sig<T, I> && I != hint && try_field(std::get<I>(fields), I)) || ...);
+	}
+	if (!found)
+		ret = r.skip_value();
+	return ret;
+}
+
+template<typename T, typename Fields, size_t... I>
+void lept_write_members(lept_writer& w, const T& v, const Fields& fields, std::index_sequence<I...>)
+{
+	auto put_field = [&](const auto& f, size_t i) {
+		if (i) w.raw(',');
+		w.raw(f.key, f.len + 3);
+		lept_write_from(w, v.*(f.member));
+	};
+	(put_field(std::get<I>(fields), I), ...);
+}
+
+template<typename T>
+struct lept_bind<T, std::enable_if_t<lept_is_reflected<T>::value>>
+{
+	static int read(lept_reader& r, T& out)
+	{
+		constexpr auto fields = lept_reflect_fields((const T*)nullptr);
+		constexpr size_t count = std::tuple_size<decltype(fields)>::value;
+		std::string_view key;
+		size_t hint = 0;
+		bool more;
+		int ret;
+		if ((ret = r.begin_object()) != LEPT_PARSE_OK)
+			return ret;
+		while ((ret = r.next_key(key, more)) == LEPT_PARSE_OK && more)
+			if ((ret = lept_read_member(r, out, fields, key, hint, std::make_index_sequence<count>())) != LEPT_PARSE_OK)
+				return ret;
+		return ret;
+	}
+
+	static void write(lept_writer& w, const T& v)
+	{
+		constexpr auto fields = lept_reflect_fields((const T*)nullptr);
+		constexpr size_t count = std::tuple_size<decltype(fields)>::value;
+		w.raw('{');
+		lept_write_members(w, v, fields, std::make_index_sequence<count>());
+		w.raw('}');
+	}
+};
+
+template<typename T>
+int lept_read(std::string_view json, T& out)
+{
+	lept_reader r(json);
+	int ret = lept_read_into(r, out);
+	if (ret == LEPT_PARSE_OK)
+		ret = r.finish();
+	return ret;
+}
+
+template<typename T>
+T lept_read(std::string_view json, int* ret = nullptr)
+{
+	T out{};
+	int r = lept_read(json, out);
+	if (ret)
+		*ret = r;
+	return out;
+}
+
+template<typename T>
+void lept_write(const T& v, lept_writer& w)
+{
+	lept_write_from(w, v);
+}
+
+template<typename T>
+void lept_write(const T& v, lept_sink& out)
+{
+	lept_writer w(out);
+	lept_write_from(w, v);
+}
+
+template<typename T>
+std::string lept_write(const T& v)
+{
+	std::string out;
+	lept_string_sink sink(out);
+	lept_write(v, sink);
+	return out;
+}
@@ -0,0 +1,283 @@
+#include "leptjson_scan.h"
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include "double-conversion.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace double_conversion;
+
+void lept_append_utf8(std::string& s, unsigned u) {
+	char buf[4];
+	size_t n;
+	if (u <= 0x7F) {
+		buf[0] = (char)u;
+		n = 1;
+	}
+	else if (u <= 0x7FF) {
+		buf[0] = (char)(0xC0 | (u >> 6));
+		buf[1] = (char)(0x80 | (u & 0x3F));
+		n = 2;
+	}
+	else if (u <= 0xFFFF) {
+		buf[0] = (char)(0xE0 | (u >> 12));
+		buf[1] = (char)(0x80 | ((u >> 6) & 0x3F));
+		buf[2] = (char)(0x80 | (u & 0x3F));
+		n = 3;
+	}
+	else {
+		assert(u <= 0x10FFFF);
+		buf[0] = (char)(0xF0 | (u >> 18));
+		buf[1] = (char)(0x80 | ((u >> 12) & 0x3F));
+		buf[2] = (char)(0x80 | ((u >> 6) & 0x3F));
+		buf[3] = (char)(0x80 | (u & 0x3F));
+		n = 4;
+	}
+	s.append(buf, n);
+}
+
+/* Value of each byte as a hex digit, -1 if it is not one. */
+struct lept_hex_table {
+	signed char v[256];
+
+	constexpr lept_hex_table() : v() {
+		for (int i = 0; i < 256; i++) v[i] = -1;
+		for (int i = 0; i < 10; i++) v['0' + i] = (signed char)i;
+		for (int i = 0; i < 6; i++) v['a' + i] = v['A' + i] = (signed char)(10 + i);
+	}
+};
+static constexpr lept_hex_table lept_hex;
+
+static bool lept_hex4(const char* p, const char* end, unsigned* u) {
+	if (end - p < 4)
+		return false;
+	const unsigned char* s = (const unsigned char*)p;
+	int h0 = lept_hex.v[s[0]], h1 = lept_hex.v[s[1]], h2 = lept_hex.v[s[2]], h3 = lept_hex.v[s[3]];
+	if ((h0 | h1 | h2 | h3) < 0)
+		return false;
+	*u = (unsigned)(h0 << 12 | h1 << 8 | h2 << 4 | h3);
+	return true;
+}
+
+int lept_unescape(const char*& p, const char* end, std::string* out, unsigned flags) {
+	char esc;
+	unsigned u, u2;
+	if (p == end)
+		return LEPT_PARSE_MISS_QUOTATION_MARK;
+	switch (*p++) {
+		case '\"': esc = '\"'; break;
+		case '\\': esc = '\\'; break;
+		case '/': esc = '/'; break;
+		case 'b': esc = '\b'; break;
+		case 'f': esc = '\f'; break;
+		case 'n': esc = '\n'; break;
+		case 'r': esc = '\r'; break;
+		case 't': esc = '\t'; break;
+		case 'u':
+			if (!lept_hex4(p, end, &u))
+				return LEPT_PARSE_INVALID_UNICODE_HEX;
+			p += 4;
+			if (u >= 0xD800 && u <= 0xDBFF) {
+				if (end - p < 2 || p[0] != '\\' || p[1] != 'u')
+					return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
+				if (!lept_hex4(p + 2, end, &u2))
+					return LEPT_PARSE_INVALID_UNICODE_HEX;
+				p += 6;
+				if (u2 < 0xDC00 || u2 > 0xDFFF)
+					return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
+				u = (((u - 0xD800) << 10) | (u2 - 0xDC00)) + 0x10000;
+			}
+			else if (u >= 0xDC00 && u <= 0xDFFF && (flags & LEPT_PARSE_STRICT_UTF8))
+				return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
+			if (out)
+				lept_append_utf8(*out, u);
+			return LEPT_PARSE_OK;
+		default:
+			return LEPT_PARSE_INVALID_STRING_ESCAPE;
+	}
+	if (out)
+		out->push_back(esc);
+	return LEPT_PARSE_OK;
+}
+
+int lept_scan_number(const char* p, const char* end, const char*& stop, bool& is_integer) {
+	const char* q = p;
+	is_integer = true;
+	if (q < end && *q == '-') q++;
+	if (q < end && *q == '0') q++;
+	else {
+		if (q == end || !ISDIGIT1TO9(*q)) return LEPT_PARSE_INVALID_VALUE;
+		for (q++; q < end && ISDIGIT(*q); q++);
+	}
+	if (q < end && *q == '.') {
+		is_integer = false;
+		q++;
+		if (q == end || !ISDIGIT(*q)) return LEPT_PARSE_INVALID_VALUE;
+		for (q++; q < end && ISDIGIT(*q); q++);
+	}
+	if (q < end && (*q == 'e' || *q == 'E')) {
+		is_integer = false;
+		q++;
+		if (q < end && (*q == '+' || *q == '-')) q++;
+		if (q == end || !ISDIGIT(*q)) return LEPT_PARSE_INVALID_VALUE;
+		for (q++; q < end && ISDIGIT(*q); q++);
+	}
+	stop = q;
+	return LEPT_PARSE_OK;
+}
+
+bool lept_number_too_big(const char* p, const char* stop, bool is_integer) {
+	bool neg = *p == '-';
+	const char* q = p + neg;
+	if (is_integer) {
+		if (stop - q < 19)
+			return false;
+		unsigned long long limit = neg ? (1ULL << 63) : (1ULL << 63) - 1, x = 0;
+		for (; q < stop; q++) {
+			unsigned d = (unsigned)(*q - '0');
+			if (x > (limit - d) / 10)
+				return true;
+			x = x * 10 + d;
+		}
+		return false;
+	}
+	/* below 1e308 whatever the digits: convert only past that */
+	long long digits = 0, exp = 0;
+	if (*q != '0')
+		for (; q < stop && ISDIGIT(*q); q++)
+			digits++;
+	const char* e = (const char*)memchr(p, 'e', (size_t)(stop - p));
+	if (!e)
+		e = (const char*)memchr(p, 'E', (size_t)(stop - p));
+	if (e) {
+		bool eneg = e[1] == '-';
+		for (q = e + 1 + (e[1] == '+' || e[1] == '-'); q < stop && exp < 100000; q++)
+			exp = exp * 10 + (*q - '0');
+		if (eneg)
+			exp = -exp;
+	}
+	if (digits + exp <= 308)
+		return false;
+	return std::isinf(lept_strtod(p, (size_t)(stop - p)));
+}
+
+double lept_strtod(const char* p, size_t len) {
+	StringToDoubleConverter converter(0, 0.0, 0.0, nullptr, nullptr);
+	int processed;
+	return converter.StringToDouble(p, (int)len, &processed);
+}
+
+long long lept_strtoll(const char* p, size_t len) {
+	bool neg = *p == '-';
+	unsigned long long x = 0;
+	for (size_t i = neg; i < len; i++)
+		x = x * 10 + (unsigned)(p[i] - '0');
+	return neg ? (long long)(0 - x) : (long long)x;
+}
+
+void lept_set_number(lept_value& v, const char* p, const char* stop, bool is_integer) {
+	size_t len = (size_t)(stop - p);
+	if (!is_integer) {
+		v.set_number(lept_strtod(p, len));
+		return;
+	}
+	long long i = lept_strtoll(p, len);
+	if (i >= INT_MIN && i <= INT_MAX)
+		v.set_integer((int)i);
+	else
+		v.set_number((double)i);
+}
+
+size_t lept_plain_run(const unsigned char* s, const unsigned char* end, bool ascii) {
+	const unsigned char* p = s;
+#ifdef __SSE2__
+	const __m128i quote = _mm_set1_epi8('\"'), backslash = _mm_set1_epi8('\\');
+	const __m128i slash = _mm_set1_epi8('/'), control = _mm_set1_epi8(0x1F);
+	for (; end - p >= 16; p += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)p);
+		__m128i special = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, backslash)),
+			_mm_or_si128(_mm_cmpeq_epi8(x, slash), _mm_cmpeq_epi8(_mm_max_epu8(x, control), control)));
+		int mask = _mm_movemask_epi8(special);
+		if (ascii)
+			mask |= _mm_movemask_epi8(x);
+		if (mask)
+			return (size_t)(p - s) + __builtin_ctz(mask);
+	}
+#endif
+	while (p < end && *p >= 0x20 && *p != '\"' && *p != '\\' && *p != '/' && !(ascii && *p >= 0x80))
+		p++;
+	return (size_t)(p - s);
+}
+
+/* Code point of the sequence led by lead, advancing p past its continuation
+ * bytes; U+FFFD for a malformed sequence, consuming only the lead. */
+static unsigned decode_utf8(unsigned lead, const unsigned char*& p, const unsigned char* end) {
+	/* the second byte's range depends on the lead, as in validate_scalar():
+	 * no overlong forms, no surrogates, nothing past U+10FFFF */
+	size_t n;
+	unsigned char lo = 0x80, hi = 0xBF;
+	if (lead >= 0xC2 && lead <= 0xDF) n = 1;
+	else if (lead >= 0xE0 && lead <= 0xEF) {
+		n = 2;
+		if (lead == 0xE0) lo = 0xA0;
+		else if (lead == 0xED) hi = 0x9F;
+	}
+	else if (lead >= 0xF0 && lead <= 0xF4) {
+		n = 3;
+		if (lead == 0xF0) lo = 0x90;
+		else if (lead == 0xF4) hi = 0x8F;
+	}
+	else
+		return 0xFFFD;
+	if ((size_t)(end - p) < n || p[0] < lo || p[0] > hi)
+		return 0xFFFD;
+	unsigned u = lead & (0x3F >> n);
+	for (size_t i = 0; i < n; i++) {
+		if ((p[i] & 0xC0) != 0x80)
+			return 0xFFFD;
+		u = u << 6 | (p[i] & 0x3F);
+	}
+	p += n;
+	return u;
+}
+
+size_t lept_escape_char(const unsigned char*& p, const unsigned char* end, char* buf) {
+	static const char hex[] = "0123456789ABCDEF";
+	unsigned u = *p++;
+	char c;
+	switch (u) {
+		case '\"': c = '\"'; break;
+		case '/': c = '/'; break;
+		case '\\': c = '\\'; break;
+		case '\b': c = 'b'; break;
+		case '\t': c = 't'; break;
+		case '\r': c = 'r'; break;
+		case '\f': c = 'f'; break;
+		case '\n': c = 'n'; break;
+		default:
+		{
+			size_t n = 0;
+			if (u >= 0x80)
+				u = decode_utf8(u, p, end);
+			if (u >= 0x10000) {
+				/* as a surrogate pair */
+				u -= 0x10000;
+				unsigned hi = 0xD800 + (u >> 10);
+				char pair[6] = { '\\', 'u', hex[hi >> 12], hex[(hi >> 8) & 0xF], hex[(hi >> 4) & 0xF], hex[hi & 0xF] };
+				memcpy(buf, pair, 6);
+				n = 6;
+				u = 0xDC00 + (u & 0x3FF);
+			}
+			char one[6] = { '\\', 'u', hex[u >> 12], hex[(u >> 8) & 0xF], hex[(u >> 4) & 0xF], hex[u & 0xF] };
+			memcpy(buf + n, one, 6);
+			return n + 6;
+		}
+	}
+	buf[0] = '\\';
+	buf[1] = c;
+	return 2;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <string_view>
+#include "leptjson.h"
+
+/* Lexical pieces shared by lept_value::parse() and lept_reader, so both
+ * accept the same text and build the same values from it, and the string
+ * escaper shared by stringify(), lept_writer and lept_codegen.  Ranges are
+ * [p, end); nothing past end is read. */
+
+#define ISDIGIT(ch) ((ch) >= '0' && (ch) <= '9')
+#define ISDIGIT1TO9(ch) ((ch) >= '1' && (ch) <= '9')
+
+/* Appends code point u, at most U+10FFFF, as UTF-8. */
+void lept_append_utf8(std::string& s, unsigned u);
+
+/* The escape after a backslash; p is just past the backslash and is left
+ * past the escape.  \uXXXX pairs are combined into one code point.  The
+ * decoded text is appended to out if it is not nullptr.  With
+ * LEPT_PARSE_STRICT_UTF8 in flags a lone low surrogate, which has no UTF-8
+ * form, is rejected like a lone high one. */
+int lept_unescape(const char*& p, const char* end, std::string* out, unsigned flags = 0);
+
+/* Checks the grammar of the number at p; stop receives its end. */
+int lept_scan_number(const char* p, const char* end, const char*& stop, bool& is_integer);
+
+/* Whether the number in [p, stop) is out of range: integers must fit a long
+ * long and doubles must be finite. */
+bool lept_number_too_big(const char* p, const char* stop, bool is_integer);
+
+/* Conversions of a scanned number that is not too big. */
+double lept_strtod(const char* p, size_t len);
+long long lept_strtoll(const char* p, size_t len);
+
+/* Stores the scanned number: an integer that fits an int as integer, any
+ * other as number. */
+void lept_set_number(lept_value& v, const char* p, const char* stop, bool is_integer);
+
+/* Length of the prefix of [s, end) that can be copied out unescaped; with
+ * ascii it also stops at non-ASCII bytes. */
+size_t lept_plain_run(const unsigned char* s, const unsigned char* end, bool ascii);
+
+/* Writes the escape of the character at p, where lept_plain_run() stopped,
+ * into buf (12 bytes) and returns its length; p is left past it.  A
+ * non-ASCII character becomes \uXXXX, or a pair of them above U+FFFF, and a
+ * malformed sequence \uFFFD. */
+size_t lept_escape_char(const unsigned char*& p, const unsigned char* end, char* buf);
+
+/* s quoted and escaped under the LEPT_STRINGIFY_* flags, handed to
+ * put(const char*, size_t) in pieces. */
+template <class Put>
+void lept_escape_string(std::string_view s, unsigned flags, Put&& put)
+{
+	bool ascii = (flags & LEPT_STRINGIFY_ENSURE_ASCII) != 0;
+	const unsigned char* p = (const unsigned char*)s.data();
+	const unsigned char* end = p + s.size();
+	char buf[12];
+	put("\"", 1);
+	for (;;) {
+		size_t run = lept_plain_run(p, end, ascii);
+		if (run)
+			put((const char*)p, run);
+		p += run;
+		if (p == end)
+			break;
+		put(buf, lept_escape_char(p, end, buf));
+	}
+	put("\"", 1);
+}
@@ -0,0 +1,464 @@
+#include "leptjson_schema.h"
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <utility>
+#include "leptjson_reader.h"
+
+enum {
+	LEPT_SCHEMA_CHECK_MIN = 1,
+	LEPT_SCHEMA_CHECK_MAX = 2,
+	LEPT_SCHEMA_CHECK_EXCLUSIVE_MIN = 4,
+	LEPT_SCHEMA_CHECK_EXCLUSIVE_MAX = 8,
+	LEPT_SCHEMA_CHECK_ENUM = 16
+};
+
+#define LEPT_TYPE_BIT(t) (1u << (unsigned)(t))
+#define LEPT_TYPE_ALL 0x7Fu
+
+/**********************************  compile  **************************************/
+
+static bool schema_type_bits(const std::string& name, unsigned& bits) {
+	if (name == "null") bits |= LEPT_TYPE_BIT(lept_type::null);
+	else if (name == "boolean") bits |= LEPT_TYPE_BIT(lept_type::boolean);
+	else if (name == "integer") bits |= LEPT_TYPE_BIT(lept_type::integer);
+	else if (name == "number") bits |= LEPT_TYPE_BIT(lept_type::integer) | LEPT_TYPE_BIT(lept_type::number);
+	else if (name == "string") bits |= LEPT_TYPE_BIT(lept_type::string);
+	else if (name == "array") bits |= LEPT_TYPE_BIT(lept_type::array);
+	else if (name == "object") bits |= LEPT_TYPE_BIT(lept_type::object);
+	else return false;
+	return true;
+}
+
+static bool schema_number(const lept_value& s, const char* key, double& d) {
+	if (!s.contains_key(key))
+		return false;
+	const lept_value& v = s[key];
+	if (v.get_type() == lept_type::integer)
+		d = v.get_integer();
+	else if (v.get_type() == lept_type::number)
+		d = v.get_number();
+	else
+		return false;
+	return true;
+}
+
+static bool schema_size(const lept_value& s, const char* key, size_t& n) {
+	double d;
+	if (!schema_number(s, key, d) || d < 0)
+		return false;
+	n = (size_t)d;
+	return true;
+}
+
+int lept_schema::compile(std::string_view schema) {
+	lept_value v;
+	if (v.parse(std::string(schema)) != LEPT_PARSE_OK)
+		return LEPT_SCHEMA_BAD_SCHEMA;
+	return compile(v);
+}
+
+int lept_schema::compile(const lept_value& schema) {
+	nodes.clear();
+	nodes.emplace_back();
+	int ret = compile_node(schema, 0);
+	if (ret != LEPT_SCHEMA_OK)
+		nodes.clear();
+	return ret;
+}
+
+int lept_schema::compile_node(const lept_value& s, size_t index) {
+	lept_schema_node n;
+	n.types = LEPT_TYPE_ALL;
+	n.checks = 0;
+	n.minimum = n.maximum = 0;
+	n.min_length = n.min_items = 0;
+	n.max_length = n.max_items = npos;
+	n.items = npos;
+	n.required = 0;
+
+	if (s.get_type() == lept_type::boolean) {
+		/* true accepts everything, false nothing */
+		if (!s.get_boolean())
+			n.types = 0;
+		nodes[index] = std::move(n);
+		return LEPT_SCHEMA_OK;
+	}
+	if (s.get_type() != lept_type::object)
+		return LEPT_SCHEMA_BAD_SCHEMA;
+
+	if (s.contains_key("type")) {
+		const lept_value& t = s["type"];
+		n.types = 0;
+		if (t.get_type() == lept_type::string) {
+			if (!schema_type_bits(t.get_string(), n.types))
+				return LEPT_SCHEMA_BAD_SCHEMA;
+		}
+		else if (t.get_type() == lept_type::array) {
+			for (size_t i = 0; i < t.get_array_size(); i++)
+				if (t[(int)i].get_type() != lept_type::string || !schema_type_bits(t[(int)i].get_string(), n.types))
+					return LEPT_SCHEMA_BAD_SCHEMA;
+		}
+		else
+			return LEPT_SCHEMA_BAD_SCHEMA;
+	}
+
+	double d;
+	if (schema_number(s, "minimum", d)) {
+		n.checks |= LEPT_SCHEMA_CHECK_MIN;
+		n.minimum = d;
+	}
+	if (schema_number(s, "exclusiveMinimum", d) && (!(n.checks & LEPT_SCHEMA_CHECK_MIN) || d >= n.minimum)) {
+		n.checks |= LEPT_SCHEMA_CHECK_MIN | LEPT_SCHEMA_CHECK_EXCLUSIVE_MIN;
+		n.minimum = d;
+	}
+	if (schema_number(s, "maximum", d)) {
+		n.checks |= LEPT_SCHEMA_CHECK_MAX;
+		n.maximum = d;
+	}
+	if (schema_number(s, "exclusiveMaximum", d) && (!(n.checks & LEPT_SCHEMA_CHECK_MAX) || d <= n.maximum)) {
+		n.checks |= LEPT_SCHEMA_CHECK_MAX | LEPT_SCHEMA_CHECK_EXCLUSIVE_MAX;
+		n.maximum = d;
+	}
+	schema_size(s, "minLength", n.min_length);
+	schema_size(s, "maxLength", n.max_length);
+	schema_size(s, "minItems", n.min_items);
+	schema_size(s, "maxItems", n.max_items);
+
+	if (s.contains_key("pattern")) {
+		if (s["pattern"].get_type() != lept_type::string)
+			return LEPT_SCHEMA_BAD_SCHEMA;
+		try {
+			n.pattern = std::make_shared<std::regex>(s["pattern"].get_string(), std::regex::ECMAScript);
+		}
+		catch (const std::regex_error&) {
+			return LEPT_SCHEMA_BAD_SCHEMA;
+		}
+	}
+
+	if (s.contains_key("enum")) {
+		const lept_value& e = s["enum"];
+		if (e.get_type() != lept_type::array)
+			return LEPT_SCHEMA_BAD_SCHEMA;
+		for (size_t i = 0; i < e.get_array_size(); i++)
+			n.enums.push_back(e[(int)i]);
+		n.checks |= LEPT_SCHEMA_CHECK_ENUM;
+	}
+	if (s.contains_key("const")) {
+		n.enums.assign(1, s["const"]);
+		n.checks |= LEPT_SCHEMA_CHECK_ENUM;
+	}
+
+	/* children are appended after this node, so n is stored last */
+	if (s.contains_key("items")) {
+		n.items = nodes.size();
+		nodes.emplace_back();
+		int ret = compile_node(s["items"], n.items);
+		if (ret != LEPT_SCHEMA_OK)
+			return ret;
+	}
+	if (s.contains_key("properties")) {
+		const lept_value& props = s["properties"];
+		if (props.get_type() != lept_type::object)
+			return LEPT_SCHEMA_BAD_SCHEMA;
+		/* object_t iterates in key order, which keeps props sorted */
+		for (auto& item : props.get_object()) {
+			size_t child = nodes.size();
+			nodes.emplace_back();
+			int ret = compile_node(item.second, child);
+			if (ret != LEPT_SCHEMA_OK)
+				return ret;
+			n.props.push_back(lept_schema_prop{ item.first, child, -1 });
+		}
+	}
+	if (s.contains_key("required")) {
+		const lept_value& req = s["required"];
+		int bits = 0;
+		if (req.get_type() != lept_type::array || req.get_array_size() > 64)
+			return LEPT_SCHEMA_BAD_SCHEMA;
+		for (size_t i = 0; i < req.get_array_size(); i++) {
+			if (req[(int)i].get_type() != lept_type::string)
+				return LEPT_SCHEMA_BAD_SCHEMA;
+			const std::string& name = req[(int)i].get_string();
+			auto it = std::lower_bound(n.props.begin(), n.props.end(), name,
+				[](const lept_schema_prop& p, const std::string& k) { return p.name < k; });
+			if (it == n.props.end() || it->name != name) {
+				/* required but otherwise unconstrained */
+				size_t child = nodes.size();
+				nodes.emplace_back();
+				compile_node(lept_value(true), child);
+				it = n.props.insert(it, lept_schema_prop{ name, child, -1 });
+			}
+			if (it->bit < 0)
+				it->bit = bits++;
+		}
+		for (auto& p : n.props)
+			if (p.bit >= 0)
+				n.required |= 1ull << p.bit;
+	}
+
+	nodes[index] = std::move(n);
+	return LEPT_SCHEMA_OK;
+}
+
+/**********************************  validate  **************************************/
+
+/* One validation pass; out is null when only checking. */
+class lept_schema_run
+{
+public:
+	lept_schema_run(const lept_schema& s, std::string_view json, lept_schema_error* err)
+		: s(s), json(json), r(json), err(err) {}
+
+	int run(lept_value* out) {
+		int ret = check(0, out);
+		if (ret == LEPT_SCHEMA_OK && (ret = r.finish()) != LEPT_PARSE_OK)
+			return parse_error(ret);
+		return ret;
+	}
+
+private:
+	const lept_schema& s;
+	std::string_view json;
+	lept_reader r;
+	lept_schema_error* err;
+	std::string str;
+
+	int parse_error(int code) {
+		if (err) {
+			err->code = code;
+			err->offset = r.offset();
+			err->path.clear();
+		}
+		return LEPT_SCHEMA_PARSE_ERROR;
+	}
+
+	int invalid(int code, size_t offset) {
+		if (err) {
+			err->code = code;
+			err->offset = offset;
+			err->path.clear();
+		}
+		return LEPT_SCHEMA_INVALID;
+	}
+
+	/* Called while unwinding so the path is only built on failure. */
+	void prefix(std::string_view seg) {
+		if (!err)
+			return;
+		std::string p = "/";
+		for (char c : seg) {
+			if (c == '~') p += "~0";
+			else if (c == '/') p += "~1";
+			else p.push_back(c);
+		}
+		err->path.insert(0, p);
+	}
+
+	static bool in_enum(const lept_schema_node& n, const lept_value& v) {
+		return std::find(n.enums.begin(), n.enums.end(), v) != n.enums.end();
+	}
+
+	int check(size_t index, lept_value* out) {
+		const lept_schema_node& n = s.nodes[index];
+		lept_type type;
+		int ret;
+		if ((ret = r.peek(type)) != LEPT_PARSE_OK)
+			return parse_error(ret);
+		size_t start = r.offset();
+		bool ok = (n.types & LEPT_TYPE_BIT(type)) != 0;
+		/* a fraction may still hold an integral value */
+		if (!ok && type != lept_type::number)
+			return invalid(LEPT_SCHEMA_TYPE, start);
+
+		switch (type) {
+			case lept_type::null:
+			case lept_type::boolean:
+				if ((ret = out ? r.read_value(*out) : r.skip_value()) != LEPT_PARSE_OK)
+					return parse_error(ret);
+				break;
+			case lept_type::integer:
+			case lept_type::number:
+				if ((ret = check_number(n, ok, out)) != LEPT_SCHEMA_OK)
+					return ret;
+				break;
+			case lept_type::string:
+				if ((ret = check_string(n, out)) != LEPT_SCHEMA_OK)
+					return ret;
+				break;
+			case lept_type::array:
+				if ((ret = check_array(n, out)) != LEPT_SCHEMA_OK)
+					return ret;
+				break;
+			case lept_type::object:
+				if ((ret = check_object(n, out)) != LEPT_SCHEMA_OK)
+					return ret;
+				break;
+		}
+
+		if (n.checks & LEPT_SCHEMA_CHECK_ENUM) {
+			/* rare enough that rebuilding the value is fine */
+			lept_value tmp;
+			if (!out) {
+				tmp.parse(std::string(json.substr(start, r.offset() - start)));
+				out = &tmp;
+			}
+			if (!in_enum(n, *out))
+				return invalid(LEPT_SCHEMA_ENUM, start);
+		}
+		return LEPT_SCHEMA_OK;
+	}
+
+	int check_number(const lept_schema_node& n, bool ok, lept_value* out) {
+		size_t start = r.offset();
+		double d;
+		int ret;
+		if (out) {
+			if ((ret = r.read_value(*out)) != LEPT_PARSE_OK)
+				return parse_error(ret);
+			d = out->get_type() == lept_type::integer ? out->get_integer() : out->get_number();
+		}
+		else if ((ret = r.read_number(d)) != LEPT_PARSE_OK)
+			return parse_error(ret);
+		if (!ok && !((n.types & LEPT_TYPE_BIT(lept_type::integer)) && isfinite(d) && d == floor(d)))
+			return invalid(LEPT_SCHEMA_TYPE, start);
+		if (n.checks & LEPT_SCHEMA_CHECK_MIN) {
+			if (d < n.minimum || ((n.checks & LEPT_SCHEMA_CHECK_EXCLUSIVE_MIN) && d == n.minimum))
+				return invalid(LEPT_SCHEMA_MINIMUM, start);
+		}
+		if (n.checks & LEPT_SCHEMA_CHECK_MAX) {
+			if (d > n.maximum || ((n.checks & LEPT_SCHEMA_CHECK_EXCLUSIVE_MAX) && d == n.maximum))
+				return invalid(LEPT_SCHEMA_MAXIMUM, start);
+		}
+		return LEPT_SCHEMA_OK;
+	}
+
+	int check_string(const lept_schema_node& n, lept_value* out) {
+		size_t start = r.offset();
+		int ret;
+		if (n.min_length == 0 && n.max_length == lept_schema::npos && !n.pattern) {
+			if ((ret = out ? r.read_value(*out) : r.skip_value()) != LEPT_PARSE_OK)
+				return parse_error(ret);
+			return LEPT_SCHEMA_OK;
+		}
+		if ((ret = r.read_string(str)) != LEPT_PARSE_OK)
+			return parse_error(ret);
+		/* lengths count code points, not bytes */
+		size_t len = 0;
+		for (unsigned char c : str)
+			len += (c & 0xC0) != 0x80;
+		if (len < n.min_length)
+			return invalid(LEPT_SCHEMA_MIN_LENGTH, start);
+		if (len > n.max_length)
+			return invalid(LEPT_SCHEMA_MAX_LENGTH, start);
+		if (n.pattern && !std::regex_search(str, *n.pattern))
+			return invalid(LEPT_SCHEMA_PATTERN, start);
+		if (out)
+			out->set_string(str);
+		return LEPT_SCHEMA_OK;
+	}
+
+	int check_array(const lept_schema_node& n, lept_value* out) {
+		size_t start = r.offset();
+		lept_value::array_t arr;
+		size_t count = 0;
+		bool more;
+		int ret;
+		if ((ret = r.begin_array()) != LEPT_PARSE_OK)
+			return parse_error(ret);
+		while ((ret = r.next_element(more)) == LEPT_PARSE_OK && more) {
+			if (count == n.max_items)
+				return invalid(LEPT_SCHEMA_MAX_ITEMS, start);
+			lept_value* e = out ? &arr.emplace_back() : nullptr;
+			if (n.items != lept_schema::npos) {
+				if ((ret = check(n.items, e)) != LEPT_SCHEMA_OK) {
+					prefix(std::to_string(count));
+					return ret;
+				}
+			}
+			else if ((ret = e ? r.read_value(*e) : r.skip_value()) != LEPT_PARSE_OK)
+				return parse_error(ret);
+			count++;
+		}
+		if (ret != LEPT_PARSE_OK)
+			return parse_error(ret);
+		if (count < n.min_items)
+			return invalid(LEPT_SCHEMA_MIN_ITEMS, start);
+		if (out)
+			out->set_array(std::move(arr));
+		return LEPT_SCHEMA_OK;
+	}
+
+	int check_object(const lept_schema_node& n, lept_value* out) {
+		size_t start = r.offset();
+		lept_value::object_t obj;
+		unsigned long long seen = 0;
+		/* properties met so far; like parse(), the first of duplicate keys wins */
+		std::vector<bool> met(n.props.size());
+		std::string_view key;
+		bool more;
+		int ret;
+		if ((ret = r.begin_object()) != LEPT_PARSE_OK)
+			return parse_error(ret);
+		while ((ret = r.next_key(key, more)) == LEPT_PARSE_OK && more) {
+			lept_value* m = nullptr;
+			bool dup = false;
+			if (out) {
+				auto ins = obj.try_emplace(std::string(key));
+				m = &ins.first->second;
+				dup = !ins.second;
+			}
+			auto it = std::lower_bound(n.props.begin(), n.props.end(), key,
+				[](const lept_schema_prop& p, std::string_view k) { return std::string_view(p.name) < k; });
+			bool known = it != n.props.end() && it->name == key;
+			if (known) {
+				dup = met[it - n.props.begin()];
+				met[it - n.props.begin()] = true;
+			}
+			if (dup) {
+				if ((ret = r.skip_value()) != LEPT_PARSE_OK)
+					return parse_error(ret);
+			}
+			else if (known) {
+				if ((ret = check(it->node, m)) != LEPT_SCHEMA_OK) {
+					prefix(it->name);
+					return ret;
+				}
+				if (it->bit >= 0)
+					seen |= 1ull << it->bit;
+			}
+			else if ((ret = m ? r.read_value(*m) : r.skip_value()) != LEPT_PARSE_OK)
+				return parse_error(ret);
+		}
+		if (ret != LEPT_PARSE_OK)
+			return parse_error(ret);
+		if ((seen & n.required) != n.required) {
+			int ret = invalid(LEPT_SCHEMA_REQUIRED, start);
+			for (auto& p : n.props)
+				if (p.bit >= 0 && !(seen & (1ull << p.bit))) {
+					prefix(p.name);
+					break;
+				}
+			return ret;
+		}
+		if (out)
+			out->set_object(std::move(obj));
+		return LEPT_SCHEMA_OK;
+	}
+};
+
+int lept_schema::validate(std::string_view json, lept_schema_error* err) const {
+	assert(!nodes.empty());
+	lept_schema_run run(*this, json, err);
+	return run.run(nullptr);
+}
+
+int lept_schema::parse(std::string_view json, lept_value& v, lept_schema_error* err) const {
+	assert(!nodes.empty());
+	lept_schema_run run(*this, json, err);
+	lept_value tmp;
+	int ret = run.run(&tmp);
+	if (ret == LEPT_SCHEMA_OK)
+		v = std::move(tmp);
+	return ret;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stddef.h>
+#include <memory>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "leptjson.h"
+
+/* JSON Schema validation (a draft 2020-12 subset) driven by lept_reader.
+ *
+ *	lept_schema s;
+ *	s.compile(schema_json);
+ *	int ret = s.validate(request, &err);	(or s.parse(request, v, &err))
+ *
+ * compile() turns the schema into a table of nodes once.  validate() then
+ * checks each value as the reader reaches it, so a document is rejected at
+ * the first violation, without building a lept_value tree; parse() does the
+ * same and also builds the tree, which is kept only if the document is valid.
+ *
+ * Keywords: type, properties, required, items, enum, const, minimum,
+ * maximum, exclusiveMinimum, exclusiveMaximum, minLength, maxLength,
+ * minItems, maxItems and pattern (ECMAScript syntax, searched anywhere in the
+ * string).  Others are ignored.  At most 64 required names per object. */
+
+enum {
+	LEPT_SCHEMA_OK = 0,
+	LEPT_SCHEMA_BAD_SCHEMA,
+	LEPT_SCHEMA_PARSE_ERROR,	/* err->code holds the LEPT_PARSE_* code */
+	LEPT_SCHEMA_INVALID		/* err->code holds the failing keyword */
+};
+
+/* keyword codes for LEPT_SCHEMA_INVALID */
+enum {
+	LEPT_SCHEMA_TYPE = 1,
+	LEPT_SCHEMA_REQUIRED,
+	LEPT_SCHEMA_ENUM,
+	LEPT_SCHEMA_MINIMUM,
+	LEPT_SCHEMA_MAXIMUM,
+	LEPT_SCHEMA_MIN_LENGTH,
+	LEPT_SCHEMA_MAX_LENGTH,
+	LEPT_SCHEMA_MIN_ITEMS,
+	LEPT_SCHEMA_MAX_ITEMS,
+	LEPT_SCHEMA_PATTERN
+};
+
+struct lept_schema_error
+{
+	int code;
+	size_t offset;		/* where the offending value starts */
+	std::string path;	/* JSON Pointer to it */
+};
+
+struct lept_schema_prop
+{
+	std::string name;
+	size_t node;
+	int bit;			/* -1 unless required */
+};
+
+struct lept_schema_node
+{
+	unsigned types;		/* 1 << lept_type; all set when unconstrained */
+	unsigned checks;	/* LEPT_SCHEMA_CHECK_* */
+	double minimum, maximum;
+	size_t min_length, max_length;
+	size_t min_items, max_items;
+	size_t items;		/* node index, or npos */
+	unsigned long long required;
+	std::vector<lept_schema_prop> props;	/* sorted by name */
+	std::vector<lept_value> enums;
+	std::shared_ptr<std::regex> pattern;
+};
+
+class lept_schema
+{
+public:
+	int compile(const lept_value& schema);
+	int compile(std::string_view schema);
+	/* lept_value converts from these too, so pick the text overload */
+	int compile(const char* schema) { return compile(std::string_view(schema)); }
+	int compile(const std::string& schema) { return compile(std::string_view(schema)); }
+
+	int validate(std::string_view json, lept_schema_error* err = nullptr) const;
+	int parse(std::string_view json, lept_value& v, lept_schema_error* err = nullptr) const;
+
+	static const size_t npos = (size_t)-1;
+
+private:
+	std::vector<lept_schema_node> nodes;	/* nodes[0] is the root */
+
+	int compile_node(const lept_value& s, size_t index);
+	friend class lept_schema_run;
+};
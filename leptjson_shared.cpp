@@ -0,0 +1,93 @@
+#include "leptjson_shared.h"
+#include <assert.h>
+#include <utility>
+
+static const int LEPT_SHARED_COUNT_SHIFT = 48;
+static const uint64_t LEPT_SHARED_ONE = 1ULL << LEPT_SHARED_COUNT_SHIFT;
+static const uint64_t LEPT_SHARED_PTR_MASK = LEPT_SHARED_ONE - 1;
+/* acquisitions past this are moved out of the state word */
+static const uint64_t LEPT_SHARED_FLUSH = 1ULL << 15;
+/* held by the published slot; far above any count of live readers */
+static const int64_t LEPT_SHARED_BIAS = 1LL << 40;
+
+struct lept_shared_node {
+	lept_value value;
+	std::atomic<int64_t> refs;
+
+	explicit lept_shared_node(lept_value&& v) : value(std::move(v)), refs(LEPT_SHARED_BIAS) {}
+};
+
+static lept_shared_node* unpack(uint64_t s) {
+	return reinterpret_cast<lept_shared_node*>(s & LEPT_SHARED_PTR_MASK);
+}
+
+static uint64_t pack(lept_shared_node* node) {
+	uint64_t p = (uint64_t)reinterpret_cast<uintptr_t>(node);
+	assert((p & ~LEPT_SHARED_PTR_MASK) == 0);
+	return p;
+}
+
+static void drop(lept_shared_node* node, int64_t n) {
+	if (node->refs.fetch_sub(n, std::memory_order_acq_rel) == n)
+		delete node;
+}
+
+/* The slot no longer points at node: turn its bias into the count of
+ * acquisitions it recorded. */
+static void retire(lept_shared_node* node, uint64_t acquired) {
+	drop(node, LEPT_SHARED_BIAS - (int64_t)acquired);
+}
+
+lept_shared_document::lept_shared_document() : lept_shared_document(lept_value()) {}
+
+lept_shared_document::lept_shared_document(lept_value v)
+	: state(pack(new lept_shared_node(std::move(v)))) {}
+
+lept_shared_document::~lept_shared_document() {
+	uint64_t s = state.load(std::memory_order_acquire);
+	retire(unpack(s), s >> LEPT_SHARED_COUNT_SHIFT);
+}
+
+lept_shared_document::snapshot lept_shared_document::acquire() const {
+	uint64_t s = state.fetch_add(LEPT_SHARED_ONE, std::memory_order_acquire) + LEPT_SHARED_ONE;
+	lept_shared_node* node = unpack(s);
+	uint64_t count = s >> LEPT_SHARED_COUNT_SHIFT;
+	if (count >= LEPT_SHARED_FLUSH) {
+		/* Credit the node first, then take the same amount off the word.
+		 * If a writer swapped the node out meanwhile it has counted these
+		 * acquisitions itself, so the credit is taken back; the reference
+		 * being returned keeps the node alive through that. */
+		node->refs.fetch_add((int64_t)count, std::memory_order_relaxed);
+		uint64_t cur = s;
+		while (unpack(cur) == node && (cur >> LEPT_SHARED_COUNT_SHIFT) >= count) {
+			if (state.compare_exchange_weak(cur, cur - count * LEPT_SHARED_ONE, std::memory_order_relaxed))
+				return snapshot(node);
+		}
+		drop(node, (int64_t)count);
+	}
+	return snapshot(node);
+}
+
+void lept_shared_document::publish(lept_value v) {
+	lept_shared_node* node = new lept_shared_node(std::move(v));
+	uint64_t old = state.exchange(pack(node), std::memory_order_acq_rel);
+	retire(unpack(old), old >> LEPT_SHARED_COUNT_SHIFT);
+}
+
+lept_shared_document::snapshot::snapshot(const snapshot& rhs) : node(rhs.node) {
+	/* rhs holds a reference, so the count cannot reach zero here */
+	if (node)
+		node->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+const lept_value& lept_shared_document::snapshot::operator*() const {
+	assert(node);
+	return node->value;
+}
+
+void lept_shared_document::snapshot::release() {
+	if (node) {
+		drop(node, 1);
+		node = nullptr;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <utility>
+#include "leptjson.h"
+
+struct lept_shared_node;
+
+/* A published document that many threads read while one thread replaces it.
+ *
+ *	lept_shared_document config;
+ *	config.publish(std::move(parsed));		(writer)
+ *	auto snap = config.acquire();			(any reader)
+ *	int port = (*snap)["port"].get_integer();
+ *
+ * acquire() is a single atomic fetch_add and never waits: the published
+ * pointer and a 16-bit count of acquisitions share one 64-bit word.  Each
+ * version also holds its own reference count, biased while published.
+ * Releasing a snapshot decrements that count.  When a version is replaced,
+ * the writer settles the bias against the acquisitions recorded in the
+ * word, and whoever drops the last reference frees the version.  A reader
+ * that sees the acquisition count pass half its range moves it into the
+ * version's own count, so the word cannot overflow.
+ *
+ * A snapshot never changes; it stays valid after newer versions are
+ * published.  snap->share() takes a cheap copy-on-write handle to the
+ * value out of it.  Pointers must fit in 48 bits, as on x86-64 and AArch64. */
+class lept_shared_document
+{
+public:
+	class snapshot
+	{
+	public:
+		snapshot() : node(nullptr) {}
+		snapshot(const snapshot& rhs);
+		snapshot(snapshot&& rhs) noexcept : node(rhs.node) { rhs.node = nullptr; }
+		snapshot& operator=(snapshot rhs) noexcept
+		{
+			std::swap(node, rhs.node);
+			return *this;
+		}
+		~snapshot() { release(); }
+
+		const lept_value& operator*() const;
+		const lept_value* operator->() const { return &**this; }
+		explicit operator bool() const { return node != nullptr; }
+		void release();
+
+	private:
+		friend class lept_shared_document;
+		explicit snapshot(lept_shared_node* node) : node(node) {}
+		lept_shared_node* node;
+	};
+
+	lept_shared_document();
+	explicit lept_shared_document(lept_value v);
+	~lept_shared_document();
+	lept_shared_document(const lept_shared_document&) = delete;
+	lept_shared_document& operator=(const lept_shared_document&) = delete;
+
+	snapshot acquire() const;
+	/* Replaces the current version; readers holding the old one keep it. */
+	void publish(lept_value v);
+
+private:
+	mutable std::atomic<uint64_t> state;
+};
@@ -0,0 +1,292 @@
+#include "leptjson_snapshot.h"
+#include <errno.h>
+#include <stdio.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#ifdef LEPT_SNAPSHOT_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char LEPT_SNAPSHOT_MAGIC[8] = { 'L', 'E', 'P', 'T', 'S', 'N', 'A', 'P' };
+static const uint32_t LEPT_SNAPSHOT_VERSION = 1;
+static const uint32_t LEPT_SNAPSHOT_BOM = 0x01020304;
+
+struct lept_snapshot_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t bom;
+	uint64_t size;
+	uint64_t root;
+};
+
+/**********************************  writer  **************************************/
+
+class lept_snapshot_writer {
+public:
+	explicit lept_snapshot_writer(std::string& out) : out(out) {
+		for (auto& s : scalars) s = 0;
+	}
+
+	void write(const lept_value& v) {
+		lept_snapshot_header h;
+		out.clear();
+		out.append(sizeof(h), '\0');
+		memcpy(h.magic, LEPT_SNAPSHOT_MAGIC, sizeof(h.magic));
+		h.version = LEPT_SNAPSHOT_VERSION;
+		h.bom = LEPT_SNAPSHOT_BOM;
+		h.root = write_value(v);
+		h.size = out.size();
+		memcpy(&out[0], &h, sizeof(h));
+	}
+
+private:
+	std::string& out;
+	/* views into the source document, which outlives the writer */
+	std::unordered_map<std::string_view, uint64_t> strings;
+	uint64_t scalars[3];	/* null, false, true */
+
+	void put32(uint32_t x) { out.append((const char*)&x, sizeof(x)); }
+	void put64(uint64_t x) { out.append((const char*)&x, sizeof(x)); }
+
+	uint64_t begin(lept_type t, uint32_t w) {
+		uint64_t off = out.size();
+		put32((uint32_t)t);
+		put32(w);
+		return off;
+	}
+
+	void align() {
+		out.append((8 - out.size() % 8) % 8, '\0');
+	}
+
+	uint64_t write_string(const std::string& s) {
+		auto it = strings.find(s);
+		if (it != strings.end())
+			return it->second;
+		uint64_t off = begin(lept_type::string, (uint32_t)s.size());
+		out.append(s.data(), s.size());
+		out.push_back('\0');
+		align();
+		strings.emplace(s, off);
+		return off;
+	}
+
+	uint64_t write_scalar(int slot, lept_type t, uint32_t w) {
+		if (!scalars[slot])
+			scalars[slot] = begin(t, w);
+		return scalars[slot];
+	}
+
+	uint64_t write_value(const lept_value& v) {
+		switch (v.get_type()) {
+			case lept_type::null: return write_scalar(0, lept_type::null, 0);
+			case lept_type::boolean:
+				return v.get_boolean() ? write_scalar(2, lept_type::boolean, 1) : write_scalar(1, lept_type::boolean, 0);
+			case lept_type::integer: return begin(lept_type::integer, (uint32_t)v.get_integer());
+			case lept_type::number:
+			{
+				uint64_t off = begin(lept_type::number, 0);
+				double d = v.get_number();
+				out.append((const char*)&d, sizeof(d));
+				return off;
+			}
+			case lept_type::string: return write_string(v.get_string());
+			case lept_type::array:
+			{
+				const lept_value::array_t& arr = v.get<lept_value::array_t>();
+				std::vector<uint64_t> slots;
+				slots.reserve(arr.size());
+				for (auto& e : arr)
+					slots.push_back(write_value(e));
+				uint64_t off = begin(lept_type::array, (uint32_t)slots.size());
+				for (uint64_t s : slots)
+					put64(s);
+				return off;
+			}
+			case lept_type::object:
+			{
+				const lept_value::object_t& obj = v.get_object();
+				std::vector<uint64_t> slots;
+				slots.reserve(obj.size() * 2);
+				for (auto& item : obj) {
+					slots.push_back(write_string(item.first));
+					slots.push_back(write_value(item.second));
+				}
+				uint64_t off = begin(lept_type::object, (uint32_t)obj.size());
+				for (uint64_t s : slots)
+					put64(s);
+				return off;
+			}
+		}
+		return 0;
+	}
+};
+
+void lept_snapshot_write(const lept_value& v, std::string& out) {
+	lept_snapshot_writer w(out);
+	w.write(v);
+}
+
+#ifdef LEPT_SNAPSHOT_MMAP
+int lept_snapshot_write_fd(const lept_value& v, int fd) {
+	std::string image;
+	lept_snapshot_write(v, image);
+	const char* p = image.data();
+	size_t left = image.size();
+	while (left > 0) {
+		ssize_t n = ::write(fd, p, left);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return LEPT_SNAPSHOT_IO_ERROR;
+		}
+		p += n;
+		left -= (size_t)n;
+	}
+	return LEPT_SNAPSHOT_OK;
+}
+#endif
+
+int lept_snapshot_write_file(const lept_value& v, const char* path) {
+	std::string image;
+	lept_snapshot_write(v, image);
+	FILE* fp = fopen(path, "wb");
+	if (!fp)
+		return LEPT_SNAPSHOT_IO_ERROR;
+	bool ok = fwrite(image.data(), 1, image.size(), fp) == image.size();
+	if (fclose(fp) != 0)
+		ok = false;
+	return ok ? LEPT_SNAPSHOT_OK : LEPT_SNAPSHOT_IO_ERROR;
+}
+
+/**********************************  reader  **************************************/
+
+bool lept_snapshot_view::find(std::string_view k, lept_snapshot_view& out) const {
+	assert(get_type() == lept_type::object);
+	size_t lo = 0, hi = word(1);
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		int cmp = key(mid).compare(k);
+		if (cmp == 0) {
+			out = value(mid);
+			return true;
+		}
+		if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return false;
+}
+
+lept_value lept_snapshot_view::to_value() const {
+	lept_value v;
+	switch (get_type()) {
+		case lept_type::null: break;
+		case lept_type::boolean: v.set_boolean(get_boolean()); break;
+		case lept_type::integer: v.set_integer(get_integer()); break;
+		case lept_type::number: v.set_number(get_number()); break;
+		case lept_type::string: v.set_string(std::string(get_string())); break;
+		case lept_type::array:
+		{
+			lept_value::array_t arr;
+			arr.reserve(get_array_size());
+			for (size_t i = 0; i < get_array_size(); i++)
+				arr.push_back(get_array_element(i).to_value());
+			v.set_array(std::move(arr));
+		}
+			break;
+		case lept_type::object:
+		{
+			lept_value::object_t obj;
+			for (size_t i = 0; i < get_object_size(); i++)
+				obj.emplace_hint(obj.end(), std::string(key(i)), value(i).to_value());
+			v.set_object(std::move(obj));
+		}
+			break;
+	}
+	return v;
+}
+
+int lept_snapshot::attach(const void* image, size_t n) {
+	lept_snapshot_header h;
+	close();
+	if (n < sizeof(h) || ((uintptr_t)image & 7) != 0)
+		return LEPT_SNAPSHOT_BAD_HEADER;
+	memcpy(&h, image, sizeof(h));
+	if (memcmp(h.magic, LEPT_SNAPSHOT_MAGIC, sizeof(h.magic)) != 0 || h.version != LEPT_SNAPSHOT_VERSION
+		|| h.bom != LEPT_SNAPSHOT_BOM || h.size > n || h.root + 8 > h.size)
+		return LEPT_SNAPSHOT_BAD_HEADER;
+	data = (const char*)image;
+	len = h.size;
+	return LEPT_SNAPSHOT_OK;
+}
+
+#ifdef LEPT_SNAPSHOT_MMAP
+int lept_snapshot::open_fd(int fd) {
+	struct stat st;
+	close();
+	if (fstat(fd, &st) != 0)
+		return LEPT_SNAPSHOT_IO_ERROR;
+	if ((size_t)st.st_size < sizeof(lept_snapshot_header))
+		return LEPT_SNAPSHOT_BAD_HEADER;
+	void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		return LEPT_SNAPSHOT_IO_ERROR;
+	int ret = attach(p, (size_t)st.st_size);
+	if (ret != LEPT_SNAPSHOT_OK) {
+		munmap(p, (size_t)st.st_size);
+		return ret;
+	}
+	/* unmap the whole file, not just the image it contains */
+	len = (size_t)st.st_size;
+	mapped = true;
+	return LEPT_SNAPSHOT_OK;
+}
+
+int lept_snapshot::open(const char* path) {
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return LEPT_SNAPSHOT_IO_ERROR;
+	int ret = open_fd(fd);
+	::close(fd);
+	return ret;
+}
+#else
+int lept_snapshot::open(const char* path) {
+	close();
+	FILE* fp = fopen(path, "rb");
+	if (!fp)
+		return LEPT_SNAPSHOT_IO_ERROR;
+	std::string buf;
+	char chunk[65536];
+	size_t n;
+	while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+		buf.append(chunk, n);
+	fclose(fp);
+	owned.swap(buf);
+	return attach(owned.data(), owned.size());
+}
+#endif
+
+void lept_snapshot::close() {
+#ifdef LEPT_SNAPSHOT_MMAP
+	if (mapped)
+		munmap((void*)data, len);
+#endif
+	data = nullptr;
+	len = 0;
+	mapped = false;
+	owned.clear();
+}
+
+lept_snapshot_view lept_snapshot::root() const {
+	assert(data);
+	lept_snapshot_header h;
+	memcpy(&h, data, sizeof(h));
+	return lept_snapshot_view(data, h.size, h.root);
+}
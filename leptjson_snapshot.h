@@ -0,0 +1,180 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include "leptjson.h"
+#if defined(__unix__) || defined(__APPLE__)
+#define LEPT_SNAPSHOT_MMAP 1	/* open_fd() and lept_snapshot_write_fd() exist */
+#endif
+
+/* Read-only binary snapshots of a parsed document.
+ *
+ * The layout is position independent: every reference is a byte offset from
+ * the start of the image, so one file can be mmap'ed by many processes and
+ * navigated in place.  Opening only checks the header; lookups walk records
+ * directly with no parsing and no allocation.
+ *
+ * Layout (host byte order, recorded in the header; records 8-byte aligned):
+ *   header   "LEPTSNAP", version, byte order mark, image size, root offset
+ *   scalar   u32 type, u32 payload          (null, boolean, integer)
+ *   number   u32 type, u32 0, f64
+ *   string   u32 type, u32 length, bytes, NUL
+ *   array    u32 type, u32 count, u64 element offsets[count]
+ *   object   u32 type, u32 count, {u64 key, u64 value}[count], sorted by key
+ *
+ * Identical strings (typically keys repeated across records) are stored once.
+ * Images are trusted: offsets are only checked by assertions. */
+
+enum {
+	LEPT_SNAPSHOT_OK = 0,
+	LEPT_SNAPSHOT_IO_ERROR,
+	LEPT_SNAPSHOT_BAD_HEADER
+};
+
+class lept_snapshot_view
+{
+public:
+	lept_snapshot_view() : base(nullptr), size(0), off(0) {}
+	lept_snapshot_view(const char* base, uint64_t size, uint64_t off) : base(base), size(size), off(off)
+	{
+		assert(off + 8 <= size);
+	}
+
+	lept_type get_type() const { return (lept_type)word(0); }
+
+	bool get_boolean() const
+	{
+		assert(get_type() == lept_type::boolean);
+		return word(1) != 0;
+	}
+
+	int get_integer() const
+	{
+		assert(get_type() == lept_type::integer);
+		return (int)word(1);
+	}
+
+	double get_number() const
+	{
+		assert(get_type() == lept_type::number);
+		double d;
+		memcpy(&d, base + off + 8, sizeof(d));
+		return d;
+	}
+
+	std::string_view get_string() const
+	{
+		assert(get_type() == lept_type::string);
+		return std::string_view(base + off + 8, word(1));
+	}
+
+	size_t get_array_size() const
+	{
+		assert(get_type() == lept_type::array);
+		return word(1);
+	}
+
+	lept_snapshot_view get_array_element(size_t index) const
+	{
+		assert(get_type() == lept_type::array && index < word(1));
+		return at(slot(index));
+	}
+
+	size_t get_object_size() const
+	{
+		assert(get_type() == lept_type::object);
+		return word(1);
+	}
+
+	/* i-th member in key order */
+	std::string_view key(size_t i) const
+	{
+		assert(get_type() == lept_type::object && i < word(1));
+		return at(slot(2 * i)).get_string();
+	}
+
+	lept_snapshot_view value(size_t i) const
+	{
+		assert(get_type() == lept_type::object && i < word(1));
+		return at(slot(2 * i + 1));
+	}
+
+	/* Binary search over the sorted keys; false if the key is absent. */
+	bool find(std::string_view k, lept_snapshot_view& out) const;
+
+	bool contains_key(std::string_view k) const
+	{
+		lept_snapshot_view tmp;
+		return find(k, tmp);
+	}
+
+	lept_snapshot_view operator[](std::string_view k) const
+	{
+		lept_snapshot_view tmp;
+		bool found = find(k, tmp);
+		assert(found);
+		(void)found;
+		return tmp;
+	}
+
+	lept_snapshot_view operator[](size_t index) const { return get_array_element(index); }
+
+	/* Copies the subtree into an ordinary lept_value. */
+	lept_value to_value() const;
+
+private:
+	const char* base;
+	uint64_t size;
+	uint64_t off;
+
+	uint32_t word(int i) const
+	{
+		uint32_t w;
+		memcpy(&w, base + off + 4 * i, sizeof(w));
+		return w;
+	}
+
+	uint64_t slot(size_t i) const
+	{
+		uint64_t s;
+		memcpy(&s, base + off + 8 + 8 * i, sizeof(s));
+		return s;
+	}
+
+	lept_snapshot_view at(uint64_t o) const { return lept_snapshot_view(base, size, o); }
+};
+
+class lept_snapshot
+{
+public:
+	lept_snapshot() : data(nullptr), len(0), mapped(false) {}
+	~lept_snapshot() { close(); }
+	lept_snapshot(const lept_snapshot&) = delete;
+	lept_snapshot& operator=(const lept_snapshot&) = delete;
+
+	/* Maps a snapshot file (or memfd) read-only and shared. */
+	int open(const char* path);
+#ifdef LEPT_SNAPSHOT_MMAP
+	int open_fd(int fd);
+#endif
+	/* Uses an image already in memory; it must stay alive and 8-byte aligned. */
+	int attach(const void* image, size_t len);
+	void close();
+
+	lept_snapshot_view root() const;
+
+private:
+	const char* data;
+	size_t len;
+	bool mapped;
+	std::string owned;	/* fallback where mmap is unavailable */
+};
+
+void lept_snapshot_write(const lept_value& v, std::string& out);
+#ifdef LEPT_SNAPSHOT_MMAP
+int lept_snapshot_write_fd(const lept_value& v, int fd);
+#endif
+int lept_snapshot_write_file(const lept_value& v, const char* path);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include <string>
+
+/* Byte stream endpoints used by the streaming encoders and decoders. */
+
+class lept_sink
+{
+public:
+	virtual ~lept_sink() {}
+	virtual void write(const char* data, size_t len) = 0;
+};
+
+class lept_source
+{
+public:
+	virtual ~lept_source() {}
+	/* Copies up to len bytes into buf and returns how many; 0 means end of input. */
+	virtual size_t read(char* buf, size_t len) = 0;
+};
+
+class lept_string_sink : public lept_sink
+{
+public:
+	explicit lept_string_sink(std::string& out) : out(out) {}
+
+	void write(const char* data, size_t len) override
+	{
+		out.append(data, len);
+	}
+
+private:
+	std::string& out;
+};
+
+class lept_string_source : public lept_source
+{
+public:
+	lept_string_source(const char* data, size_t len) : data(data), len(len), pos(0) {}
+	explicit lept_string_source(const std::string& s) : lept_string_source(s.data(), s.size()) {}
+
+	size_t read(char* buf, size_t n) override
+	{
+		if (n > len - pos)
+			n = len - pos;
+		memcpy(buf, data + pos, n);
+		pos += n;
+		return n;
+	}
+
+private:
+	const char* data;
+	size_t len;
+	size_t pos;
+};
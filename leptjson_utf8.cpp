@@ -0,0 +1,163 @@
+#include "leptjson_utf8.h"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LEPT_UTF8_SSSE3 1
+#include <immintrin.h>
+#endif
+
+static bool validate_scalar(const unsigned char* s, const unsigned char* end) {
+	while (s < end) {
+		unsigned char c = *s;
+		if (c < 0x80) {
+			s++;
+			continue;
+		}
+		/* Table 3-7 of the Unicode standard: the second byte's range
+		 * depends on the lead, the rest are plain continuations. */
+		size_t n;
+		unsigned char lo = 0x80, hi = 0xBF;
+		if (c >= 0xC2 && c <= 0xDF) n = 2;
+		else if (c >= 0xE0 && c <= 0xEF) {
+			n = 3;
+			if (c == 0xE0) lo = 0xA0;
+			else if (c == 0xED) hi = 0x9F;
+		}
+		else if (c >= 0xF0 && c <= 0xF4) {
+			n = 4;
+			if (c == 0xF0) lo = 0x90;
+			else if (c == 0xF4) hi = 0x8F;
+		}
+		else return false;
+		if ((size_t)(end - s) < n || s[1] < lo || s[1] > hi)
+			return false;
+		for (size_t i = 2; i < n; i++)
+			if ((s[i] & 0xC0) != 0x80)
+				return false;
+		s += n;
+	}
+	return true;
+}
+
+#ifdef LEPT_UTF8_SSSE3
+/* Error bits set by the three lookups; a pair of bytes is invalid when some
+ * bit survives in all of them. */
+enum {
+	TOO_SHORT = 1 << 0,		/* lead not followed by a continuation */
+	TOO_LONG = 1 << 1,		/* continuation after ASCII */
+	OVERLONG_3 = 1 << 2,
+	TOO_LARGE = 1 << 3,
+	SURROGATE = 1 << 4,
+	OVERLONG_2 = 1 << 5,
+	TOO_LARGE_1000 = 1 << 6,
+	OVERLONG_4 = 1 << 6,
+	TWO_CONTS = 1 << 7,		/* continuation after continuation */
+	CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS
+};
+
+#define LEPT_TABLE(a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15) \
+	_mm_setr_epi8((char)(a0), (char)(a1), (char)(a2), (char)(a3), (char)(a4), (char)(a5), (char)(a6), (char)(a7), \
+		(char)(a8), (char)(a9), (char)(a10), (char)(a11), (char)(a12), (char)(a13), (char)(a14), (char)(a15))
+
+__attribute__((target("ssse3")))
+static inline __m128i high_nibbles(__m128i v) {
+	return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F));
+}
+
+/* Errors in the 16 bytes of in, given the block before it in prev. */
+__attribute__((target("ssse3")))
+static inline __m128i check_block(__m128i in, __m128i prev) {
+	__m128i prev1 = _mm_alignr_epi8(in, prev, 15);
+	__m128i byte_1_high = _mm_shuffle_epi8(LEPT_TABLE(
+		TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+		TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+		TOO_SHORT | OVERLONG_2,
+		TOO_SHORT,
+		TOO_SHORT | OVERLONG_3 | SURROGATE,
+		TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4), high_nibbles(prev1));
+	__m128i byte_1_low = _mm_shuffle_epi8(LEPT_TABLE(
+		CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+		CARRY | OVERLONG_2,
+		CARRY,
+		CARRY,
+		CARRY | TOO_LARGE,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000), _mm_and_si128(prev1, _mm_set1_epi8(0x0F)));
+	__m128i byte_2_high = _mm_shuffle_epi8(LEPT_TABLE(
+		TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+		TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT), high_nibbles(in));
+	__m128i special = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+
+	/* The third and fourth bytes of a sequence must be continuations; there
+	 * TWO_CONTS is expected and cancels out. */
+	__m128i prev2 = _mm_alignr_epi8(in, prev, 14);
+	__m128i prev3 = _mm_alignr_epi8(in, prev, 13);
+	__m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8((char)(0xE0 - 0x80)));
+	__m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xF0 - 0x80)));
+	__m128i must23 = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8((char)0x80));
+	return _mm_xor_si128(must23, special);
+}
+
+/* Nonzero where the block ends inside a sequence. */
+__attribute__((target("ssse3")))
+static inline __m128i incomplete(__m128i in) {
+	const __m128i max = LEPT_TABLE(0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1);
+	return _mm_subs_epu8(in, max);
+}
+
+#undef LEPT_TABLE
+
+__attribute__((target("ssse3")))
+static bool validate_ssse3(const char* s, size_t len) {
+	__m128i error = _mm_setzero_si128();
+	__m128i prev = _mm_setzero_si128();
+	__m128i prev_incomplete = _mm_setzero_si128();
+	size_t i = 0;
+	for (;; i += 16) {
+		__m128i in;
+		if (i + 16 <= len)
+			in = _mm_loadu_si128((const __m128i*)(s + i));
+		else {
+			/* pad the tail with ASCII, which also flushes an unfinished
+			 * sequence into the error */
+			char tail[16] = { 0 };
+			memcpy(tail, s + i, len - i);
+			in = _mm_loadu_si128((const __m128i*)tail);
+		}
+		if (_mm_movemask_epi8(in) == 0)
+			error = _mm_or_si128(error, prev_incomplete);
+		else {
+			error = _mm_or_si128(error, check_block(in, prev));
+			prev_incomplete = incomplete(in);
+		}
+		prev = in;
+		if (i + 16 > len)
+			break;
+	}
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+}
+#endif
+
+bool lept_validate_utf8(const char* s, size_t len) {
+#ifdef LEPT_UTF8_SSSE3
+	if (__builtin_cpu_supports("ssse3"))
+		return validate_ssse3(s, len);
+#endif
+	const unsigned char* p = (const unsigned char*)s;
+	return validate_scalar(p, p + len);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stddef.h>
+
+/* True if [s, s + len) is well-formed UTF-8: no overlong forms, surrogates,
+ * code points above U+10FFFF or truncated sequences.  On x86 CPUs with SSSE3
+ * it checks 16 bytes at a time with the Keiser-Lemire nibble lookups, and
+ * otherwise falls back to a byte loop. */
+bool lept_validate_utf8(const char* s, size_t len);
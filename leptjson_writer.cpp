@@ -0,0 +1,66 @@
+#include "leptjson_writer.h"
+#include <math.h>
+#include <stdio.h>
+#include "leptjson_scan.h"
+
+void lept_writer::integer(long long i) {
+	char tmp[24];
+	char* p = tmp + sizeof(tmp);
+	unsigned long long x = i < 0 ? 0 - (unsigned long long)i : (unsigned long long)i;
+	do {
+		*--p = (char)('0' + x % 10);
+		x /= 10;
+	} while (x);
+	if (i < 0)
+		*--p = '-';
+	raw(p, (size_t)(tmp + sizeof(tmp) - p));
+}
+
+void lept_writer::number(double d) {
+	if (!std::isfinite(d)) {
+		null();
+		return;
+	}
+	char s[32];
+	int n = snprintf(s, sizeof(s), "%.17g", d);
+	raw(s, (size_t)n);
+}
+
+void lept_writer::string(std::string_view s) {
+	lept_escape_string(s, flags, [this](const char* p, size_t n) { raw(p, n); });
+}
+
+void lept_writer::value(const lept_value& v) {
+	bool first = true;
+	if (v.lazy && v.type != lept_type::string) {
+		raw(v.v.raw.text(), v.v.raw.len);
+		return;
+	}
+	switch (v.get_type()) {
+		case lept_type::null: null(); break;
+		case lept_type::boolean: boolean(v.get_boolean()); break;
+		case lept_type::integer: integer(v.get_integer()); break;
+		case lept_type::number: number(v.get_number()); break;
+		case lept_type::string: string(v.get_string_view()); break;
+		case lept_type::array:
+			raw('[');
+			for (auto& e : v.get<lept_value::array_t>()) {
+				if (!first) raw(',');
+				first = false;
+				value(e);
+			}
+			raw(']');
+			break;
+		case lept_type::object:
+			raw('{');
+			for (auto& item : v.get_object()) {
+				if (!first) raw(',');
+				first = false;
+				string(item.first);
+				raw(':');
+				value(item.second);
+			}
+			raw('}');
+			break;
+	}
+}
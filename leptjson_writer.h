@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include <string_view>
+#include "leptjson.h"
+#include "leptjson_stream.h"
+
+/* Buffered JSON token writer.  Callers emit punctuation with raw() and
+ * values through the typed calls; output reaches the sink in 4KB blocks and
+ * on flush() or destruction.  Strings and numbers come out as from
+ * lept_value::stringify(flags), lazy numbers in their source text;
+ * non-finite doubles, which JSON cannot express, are written as null. */
+class lept_writer
+{
+public:
+	/* flags are LEPT_STRINGIFY_* options */
+	explicit lept_writer(lept_sink& out, unsigned flags = 0) : out(out), len(0), flags(flags) {}
+	~lept_writer() { flush(); }
+	lept_writer(const lept_writer&) = delete;
+	lept_writer& operator=(const lept_writer&) = delete;
+
+	void raw(char c)
+	{
+		if (len == sizeof(buf))
+			flush();
+		buf[len++] = c;
+	}
+
+	void raw(const char* s, size_t n)
+	{
+		if (n > sizeof(buf) - len) {
+			flush();
+			if (n > sizeof(buf)) {
+				out.write(s, n);
+				return;
+			}
+		}
+		memcpy(buf + len, s, n);
+		len += n;
+	}
+
+	void null() { raw("null", 4); }
+	void boolean(bool b) { b ? raw("true", 4) : raw("false", 5); }
+	void integer(long long i);
+	void number(double d);
+	void string(std::string_view s);
+	/* Writes any lept_value subtree. */
+	void value(const lept_value& v);
+
+	void flush()
+	{
+		if (len) {
+			out.write(buf, len);
+			len = 0;
+		}
+	}
+
+private:
+	lept_sink& out;
+	char buf[4096];
+	size_t len;
+	unsigned flags;
+};
@@ -6,8 +6,28 @@
 #include <string> 
 #include <vector> 
 #include "leptjson.h" 
+#include "leptjson_pack.h"
+#include "leptjson_snapshot.h"
+#include "leptjson_reflect.h"
+#include "leptjson_schema.h"
+#include "leptjson_patch.h"
+#include "leptjson_shared.h"
+#include "leptjson_utf8.h"
+#include "leptjson_pool.h"
+#include "leptjson_path.h"
+#include <atomic>
+#include <thread>
+#include <numeric>
+#include "test_schema.h"
 #include <cstdio>
 #include <cstring>
+#ifdef LEPT_ASYNC
+#include "leptjson_async.h"
+#endif
+#ifdef LEPT_HAVE_WRITEV
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 
 static int main_ret = 0;
@@ -141,6 +161,9 @@ static void test_parse_string() {
 	TEST_STRING("\xF0\x9D\x84\x9E", "\"\\uD834\\uDD1E\"");  /* G clef sign U+1D11E */
 	TEST_STRING("\xF0\x9D\x84\x9E", "\"\\ud834\\udd1e\"");  /* G clef sign U+1D11E */
 #endif
+	lept_value v;
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_UNICODE_HEX, v.parse("\"\\u00gz\""));
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_UNICODE_HEX, v.parse("\"\\u00"));
 }
 
 void static test_parse_array() {
@@ -246,6 +269,30 @@ static void test_stringify() {
 	TEST_STRINGIFY("\"\\\" \\\\ \\/ \\b \\f \\n \\r \\t\"");
 	TEST_STRINGIFY("[null,false,true,123,\"abc\"]");
 	TEST_STRINGIFY("[[],[0],[0,1],[0,1,2]]"); 
+	TEST_STRINGIFY("\"\xE4\xB8\xAD\xE6\x96\x87 and ascii\"");
+	TEST_STRINGIFY("{\"\\\"key\\\"\":1,\"\xC3\xA9\":\"\\u0001\"}");
+}
+
+static void test_stringify_ascii()
+{
+	lept_value v;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse("{\"\xC3\xA9t\xC3\xA9\":[\"\xE4\xB8\xAD\xE6\x96\x87\",\"\xF0\x9D\x84\x9E\",\"plain text, long enough for a block\\n\"]}"));
+	std::string out = v.stringify(LEPT_STRINGIFY_ENSURE_ASCII);
+	EXPECT_TRUE(out == "{\"\\u00E9t\\u00E9\":[\"\\u4E2D\\u6587\",\"\\uD834\\uDD1E\",\"plain text, long enough for a block\\n\"]}");
+	lept_value back;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, back.parse(out));
+	EXPECT_TRUE(back == v);
+	EXPECT_TRUE(v.stringify(0) == v.stringify());
+
+	/* malformed bytes cannot be re-encoded */
+	lept_value bad(std::string("a\xFF" "b\xE4\xB8"));
+	EXPECT_TRUE(bad.stringify(LEPT_STRINGIFY_ENSURE_ASCII) == "\"a\\uFFFDb\\uFFFD\\uFFFD\"");
+	/* overlong forms, encoded surrogates and values past U+10FFFF as well */
+	bad.set_string("\xC0\xAF|\xE0\x80\xAF|\xED\xA0\x80|\xF0\x8F\xBF\xBF|\xF4\x90\x80\x80");
+	EXPECT_TRUE(bad.stringify(LEPT_STRINGIFY_ENSURE_ASCII) == "\"\\uFFFD\\uFFFD|\\uFFFD\\uFFFD\\uFFFD|"
+		"\\uFFFD\\uFFFD\\uFFFD|\\uFFFD\\uFFFD\\uFFFD\\uFFFD|\\uFFFD\\uFFFD\\uFFFD\\uFFFD\"");
+	bad.set_string("\xED\x9F\xBF\xEE\x80\x80\xF4\x8F\xBF\xBF");
+	EXPECT_TRUE(bad.stringify(LEPT_STRINGIFY_ENSURE_ASCII) == "\"\\uD7FF\\uE000\\uDBFF\\uDFFF\"");
 #if 0 
 	TEST_STRINGIFY(
 		"{"
@@ -329,6 +376,1217 @@ void test_template()
 	EXPECT_EQ_INT(true, arr[4].is<nullptr_t>());
 }
 
+static void test_parse_stats()
+{
+	lept_parse_stats stats;
+	lept_value v;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse(" { \"a\" : [ 1, 2.5, \"x\\ny\" ], \"b\" : { \"c\" : null } } ", stats));
+	EXPECT_EQ_INT(lept_type::object, v.get_type());
+#ifdef LEPT_PARSE_STATS
+	EXPECT_TRUE(stats.enabled);
+	EXPECT_EQ_SIZE_T(2, stats.nodes[(int)lept_type::object]);
+	EXPECT_EQ_SIZE_T(1, stats.nodes[(int)lept_type::array]);
+	EXPECT_EQ_SIZE_T(1, stats.nodes[(int)lept_type::integer]);
+	EXPECT_EQ_SIZE_T(1, stats.nodes[(int)lept_type::number]);
+	EXPECT_EQ_SIZE_T(1, stats.nodes[(int)lept_type::string]);
+	EXPECT_EQ_SIZE_T(1, stats.nodes[(int)lept_type::null]);
+	EXPECT_EQ_SIZE_T(2, stats.max_depth);
+	EXPECT_EQ_SIZE_T(1, stats.escapes);
+	EXPECT_EQ_SIZE_T(6, stats.string_bytes);
+	EXPECT_EQ_SIZE_T(1, stats.number_fast);
+	EXPECT_EQ_SIZE_T(1, stats.number_slow);
+	EXPECT_TRUE(stats.cycles[LEPT_PHASE_TOTAL] > 0);
+#else
+	EXPECT_FALSE(stats.enabled);
+	EXPECT_EQ_SIZE_T(0, stats.bytes);
+#endif
+}
+
+static void test_memory_usage()
+{
+	lept_value v;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse("[ 1, 2, 3, 4, 5 ]"));
+	lept_memory_usage u = v.memory_usage();
+	EXPECT_TRUE(u.arrays >= 5 * sizeof(lept_value));
+	EXPECT_EQ_SIZE_T(u.arrays - 5 * sizeof(lept_value), u.slack);
+	v.compact();
+	u = v.memory_usage();
+	EXPECT_EQ_SIZE_T(5 * sizeof(lept_value), u.arrays);
+	EXPECT_EQ_SIZE_T(0, u.slack);
+
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse("{ \"a long key that is not inline\" : \"and a long value that is not inline\", \"b\" : [ ] }"));
+	u = v.memory_usage();
+	EXPECT_TRUE(u.strings > 60);
+	EXPECT_TRUE(u.objects >= 2 * sizeof(lept_value::object_t::value_type));
+	EXPECT_EQ_SIZE_T(u.strings + u.arrays + u.objects, u.total());
+	v.compact();
+	EXPECT_EQ_SIZE_T(2, v.get_object_size());
+	EXPECT_TRUE(v.contains_key("a long key that is not inline"));
+	EXPECT_EQ_SIZE_T(0, v.memory_usage().slack);
+
+	/* shared handles share their containers, which count once and are not
+	 * cloned */
+	lept_value items;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, items.parse("[ \"a string that is not inline\", [ 1, 2, 3 ] ]"));
+	lept_memory_usage one = items.memory_usage();
+	lept_value::array_t pair;
+	pair.push_back(items.share());
+	pair.push_back(items.share());
+	lept_value both(std::move(pair));
+	u = both.memory_usage();
+	EXPECT_EQ_SIZE_T(one.strings, u.strings);
+	EXPECT_EQ_SIZE_T(one.arrays + 2 * sizeof(lept_value), u.arrays);
+	lept_value copy = items.share();
+	copy.compact();
+	const lept_value& ci = items;
+	const lept_value& cc = copy;
+	EXPECT_TRUE(&ci[1] == &cc[1]);
+}
+
+static void test_pack_roundtrip(const char* json)
+{
+	lept_value v, m, c;
+	std::string mbuf, cbuf;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse(json));
+
+	lept_string_sink msink(mbuf);
+	lept_msgpack_encode(v, msink);
+	lept_string_source msrc(mbuf);
+	EXPECT_EQ_INT(LEPT_PACK_OK, lept_msgpack_decode(msrc, m));
+	EXPECT_TRUE(m.stringify() == json);
+
+	lept_string_sink csink(cbuf);
+	lept_cbor_encode(v, csink);
+	lept_string_source csrc(cbuf);
+	EXPECT_EQ_INT(LEPT_PACK_OK, lept_cbor_decode(csrc, c));
+	EXPECT_TRUE(c.stringify() == json);
+}
+
+static void test_pack()
+{
+	test_pack_roundtrip("null");
+	test_pack_roundtrip("[true,false,0,127,128,255,256,65535,65536,2147483647]");
+	test_pack_roundtrip("[-1,-32,-33,-128,-129,-32768,-32769,-2147483648]");
+	test_pack_roundtrip("[1.5,-0.25,1024.5]");
+	test_pack_roundtrip("{\"a\":[1,2,{\"b\":\"0123456789012345678901234567890123456789\"}],\"c\":{}}");
+
+	lept_value v = { {"a", 1} };
+	std::string buf;
+	lept_string_sink sink(buf);
+	lept_msgpack_encode(v, sink);
+	EXPECT_EQ_SIZE_T(4, buf.size());
+	EXPECT_TRUE(buf == std::string("\x81\xa1" "a" "\x01", 4));
+
+	buf.clear();
+	v = { 1, -1, "a" };
+	lept_cbor_encode(v, sink);
+	EXPECT_TRUE(buf == std::string("\x83\x01\x20\x61\x61", 5));
+
+	/* wide integers become numbers, CBOR indefinite items and tags decode */
+	lept_value d;
+	std::string in("\xcf\x00\x00\x00\x01\x00\x00\x00\x00", 9);
+	lept_string_source src(in);
+	EXPECT_EQ_INT(LEPT_PACK_OK, lept_msgpack_decode(src, d));
+	EXPECT_EQ_INT(lept_type::number, d.get_type());
+	EXPECT_EQ_DOUBLE(4294967296.0, d.get_number());
+
+	in = std::string("\xc1\xbf\x61k\x9f\xf9\x3c\x00\x7f\x61" "a\x61" "b\xff\xff\xff", 16);
+	lept_string_source csrc(in);
+	EXPECT_EQ_INT(LEPT_PACK_OK, lept_cbor_decode(csrc, d));
+	std::string str = d.stringify();
+	EXPECT_EQ_STRING("{\"k\":[1,\"ab\"]}", str.c_str(), str.size());
+
+	in = "\x92\x01";
+	lept_string_source trunc(in);
+	EXPECT_EQ_INT(LEPT_PACK_UNEXPECTED_END, lept_msgpack_decode(trunc, d));
+	in = "\x81\x01\x01";
+	lept_string_source badkey(in);
+	EXPECT_EQ_INT(LEPT_PACK_INVALID_KEY, lept_msgpack_decode(badkey, d));
+
+	/* a decoder yields consecutive values from one stream */
+	in = "\x01\x02\x03";
+	lept_string_source seq(in);
+	lept_msgpack_decoder dec(seq);
+	int sum = 0;
+	while (dec.next(d) == LEPT_PACK_OK)
+		sum += d.get_integer();
+	EXPECT_EQ_INT(6, sum);
+
+	/* the one-shot decoders leave the values that follow in the source */
+	in = std::string("\x92\x01\xcd\x01\x00\xa3" "abc" "\x03\x61" "x\x18\x2a", 14);
+	lept_string_source rest(in);
+	EXPECT_EQ_INT(LEPT_PACK_OK, lept_msgpack_decode(rest, d));
+	str = d.stringify();
+	EXPECT_EQ_STRING("[1,256]", str.c_str(), str.size());
+	EXPECT_EQ_INT(LEPT_PACK_OK, lept_msgpack_decode(rest, d));
+	EXPECT_EQ_STRING("abc", d.get_string().c_str(), d.get_string().size());
+	EXPECT_EQ_INT(LEPT_PACK_OK, lept_cbor_decode(rest, d));
+	EXPECT_EQ_INT(3, d.get_integer());
+	EXPECT_EQ_INT(LEPT_PACK_OK, lept_cbor_decode(rest, d));
+	EXPECT_EQ_STRING("x", d.get_string().c_str(), d.get_string().size());
+	EXPECT_EQ_INT(LEPT_PACK_OK, lept_cbor_decode(rest, d));
+	EXPECT_EQ_INT(42, d.get_integer());
+	EXPECT_EQ_INT(LEPT_PACK_UNEXPECTED_END, lept_cbor_decode(rest, d));
+}
+
+static void test_snapshot()
+{
+	const char* json = "{\"a\":[1,2.5,\"x\",null,true],\"b\":{\"c\":false,\"d\":\"x\"},\"e\":-7}";
+	lept_value v;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse(json));
+
+	std::string image;
+	lept_snapshot_write(v, image);
+	lept_snapshot snap;
+	EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, snap.attach(image.data(), image.size()));
+	lept_snapshot_view root = snap.root();
+	EXPECT_EQ_INT(lept_type::object, root.get_type());
+	EXPECT_EQ_SIZE_T(3, root.get_object_size());
+	EXPECT_EQ_SIZE_T(5, root["a"].get_array_size());
+	EXPECT_EQ_INT(1, root["a"][0].get_integer());
+	EXPECT_EQ_DOUBLE(2.5, root["a"][1].get_number());
+	EXPECT_TRUE(root["a"][2].get_string() == "x");
+	EXPECT_EQ_INT(lept_type::null, root["a"][3].get_type());
+	EXPECT_TRUE(root["a"][4].get_boolean());
+	EXPECT_FALSE(root["b"]["c"].get_boolean());
+	EXPECT_EQ_INT(-7, root["e"].get_integer());
+	EXPECT_FALSE(root.contains_key("z"));
+	EXPECT_TRUE(root.key(1) == "b");
+	EXPECT_TRUE(root.to_value().stringify() == json);
+
+	const char* path = "leptjson_snapshot_test.bin";
+	EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, lept_snapshot_write_file(v, path));
+	lept_snapshot file;
+	EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, file.open(path));
+	EXPECT_TRUE(file.root()["b"]["d"].get_string() == "x");
+	file.close();
+	remove(path);
+
+#ifdef LEPT_SNAPSHOT_MMAP
+	FILE* tmp = tmpfile();
+	EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, lept_snapshot_write_fd(v, fileno(tmp)));
+	EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, file.open_fd(fileno(tmp)));
+	EXPECT_EQ_INT(-7, file.root()["e"].get_integer());
+	file.close();
+	fclose(tmp);
+#endif
+
+	image[0] = 'X';
+	EXPECT_EQ_INT(LEPT_SNAPSHOT_BAD_HEADER, snap.attach(image.data(), image.size()));
+}
+
+static void test_reader()
+{
+	const char* json = " [ 1 , { \"a\\n\" : [ true, null ] }, \"\\uD834\\uDD1E\", -2.5e1 ] ";
+	lept_reader r(json);
+	lept_value v;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, r.read_value(v));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, r.finish());
+	EXPECT_EQ_SIZE_T(4, v.get_array_size());
+	EXPECT_TRUE(v[1].contains_key("a\n"));
+	EXPECT_TRUE(v[2].get_string() == "\xF0\x9D\x84\x9E");
+	EXPECT_EQ_DOUBLE(-25.0, v[3].get_number());
+
+	/* numbers come out as parse() builds them: an int if one fits */
+	const char* numbers[] = {
+		"2147483647", "-2147483648", "2147483648", "-2147483649", "9223372036854775807",
+		"-9223372036854775808", "9223372036854775808", "0.5", "1e400",
+	};
+	for (const char* n : numbers) {
+		lept_value a, b;
+		lept_reader rn(n);
+		int ret = rn.read_value(a);
+		EXPECT_EQ_INT(b.parse(n), ret);
+		EXPECT_EQ_INT((int)b.get_type(), (int)a.get_type());
+		EXPECT_TRUE(a == b);
+	}
+	v.parse("2147483648");
+	EXPECT_EQ_DOUBLE(2147483648.0, v.get_number());
+
+	lept_reader s(json);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, s.skip_value());
+	EXPECT_EQ_INT(LEPT_PARSE_OK, s.finish());
+
+	lept_reader bad("[1, {\"a\" : \"\\x\"}]");
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_STRING_ESCAPE, bad.skip_value());
+	EXPECT_EQ_SIZE_T(14, bad.offset());
+
+	lept_reader hex("\"\\u00zz\"");
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_UNICODE_HEX, hex.skip_value());
+
+	lept_type t;
+	lept_reader types(" -0 ");
+	EXPECT_EQ_INT(LEPT_PARSE_OK, types.peek(t));
+	EXPECT_EQ_INT(lept_type::integer, t);
+}
+
+struct test_item {
+	std::string sku;
+	int count;
+	double price;
+};
+LEPT_REFLECT(test_item, sku, count, price)
+
+struct test_order {
+	long long id;
+	bool paid;
+	std::vector<test_item> items;
+	std::optional<std::string> note;
+	std::vector<int> codes;
+	lept_value extra;
+};
+LEPT_REFLECT(test_order, id, paid, items, note, codes, extra)
+
+/* members that share a length and first character */
+struct test_alike {
+	int ab;
+	int ac;
+	int b;
+};
+LEPT_REFLECT(test_alike, ab, ac, b)
+static_assert(lept_field_sig<test_alike, 1> == (2u << 8 | 'a'), "dispatch key is a constant");
+
+static void test_reflect_read()
+{
+	test_order o;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_read(
+		" { \"id\" : 9007199254740993, \"paid\" : true, \"unknown\" : { \"x\" : [ 1, \"\\u0041\" ] },"
+		" \"items\" : [ { \"price\" : 2.5, \"sku\" : \"a\\\"b\", \"count\" : 3 }, { \"sku\" : \"c\", \"count\" : -1, \"price\" : 0 } ],"
+		" \"codes\" : [ 1, 2, 3 ], \"extra\" : { \"k\" : [ null ] } } ", o));
+	EXPECT_TRUE(o.id == 9007199254740993LL);
+	EXPECT_TRUE(o.paid);
+	EXPECT_EQ_SIZE_T(2, o.items.size());
+	EXPECT_TRUE(o.items[0].sku == "a\"b");
+	EXPECT_EQ_INT(3, o.items[0].count);
+	EXPECT_EQ_DOUBLE(2.5, o.items[0].price);
+	EXPECT_EQ_INT(-1, o.items[1].count);
+	EXPECT_FALSE(o.note.has_value());
+	EXPECT_EQ_SIZE_T(3, o.codes.size());
+	EXPECT_TRUE(o.extra.stringify() == "{\"k\":[null]}");
+
+	test_item it = lept_read<test_item>("{\"sku\":\"z\",\"count\":1,\"price\":1}");
+	EXPECT_TRUE(it.sku == "z");
+	int ret;
+	lept_read<test_order>("{\"note\":\"n\"} x", &ret);
+	EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, ret);
+	EXPECT_EQ_INT(LEPT_PARSE_TYPE_MISMATCH, lept_read("{\"count\":\"3\"}", it));
+	EXPECT_EQ_INT(LEPT_PARSE_NUMBER_TOO_BIG, lept_read("{\"count\":4294967296}", it));
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_COLON, lept_read("{\"count\" 1}", it));
+
+	test_alike a = lept_read<test_alike>("{\"b\":3,\"ac\":2,\"ad\":9,\"ab\":1,\"\":0}", &ret);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, ret);
+	EXPECT_EQ_INT(1, a.ab);
+	EXPECT_EQ_INT(2, a.ac);
+	EXPECT_EQ_INT(3, a.b);
+}
+
+static void test_reflect_write()
+{
+	test_order o;
+	o.id = -42;
+	o.paid = false;
+	o.items.push_back({ "q\"/\x01", 2, 0.5 });
+	o.codes = { 7 };
+	o.extra = { {"k", "v"} };
+	std::string json = lept_write(o);
+	EXPECT_TRUE(json == "{\"id\":-42,\"paid\":false,\"items\":[{\"sku\":\"q\\\"\\/\\u0001\",\"count\":2,\"price\":0.5}],"
+		"\"note\":null,\"codes\":[7],\"extra\":{\"k\":\"v\"}}");
+
+	test_order back;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_read(json, back));
+	EXPECT_TRUE(back.id == -42);
+	EXPECT_TRUE(back.items[0].sku == o.items[0].sku);
+	EXPECT_TRUE(lept_write(back) == json);
+
+	std::string out;
+	lept_string_sink sink(out);
+	lept_write(std::vector<test_item>{ { "a", 1, 1.25 } }, sink);
+	EXPECT_TRUE(out == "[{\"sku\":\"a\",\"count\":1,\"price\":1.25}]");
+
+	/* the writer and stringify() share one escaper and keep lazy text */
+	const char* json2 = "{\"a/\\u00e9\":[0.10000000000000000001,123456789012,\"\\ud834\\udd1e\\n\"]}";
+	lept_value v;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse(json2, LEPT_PARSE_LAZY_NUMBERS));
+	for (unsigned flags : { 0u, (unsigned)LEPT_STRINGIFY_ENSURE_ASCII }) {
+		out.clear();
+		{
+			lept_writer w(sink, flags);
+			w.value(v);
+		}
+		EXPECT_TRUE(out == v.stringify(flags));
+	}
+	EXPECT_TRUE(out == "{\"a\\/\\u00E9\":[0.10000000000000000001,123456789012,\"\\uD834\\uDD1E\\n\"]}");
+}
+
+static void test_codegen()
+{
+	gen_order o;
+	std::string json = "{\"id\":7,\"paid\":true,\"items\":[{\"sku\":\"a\",\"count\":2},{\"count\":1,\"sku\":\"b\",\"price\":2.5}],"
+		"\"tags\":[\"x\",\"y\"],\"discount\":null,\"unknown\":{\"k\":[1]},\"meta\":{\"m\":1}}";
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_gen_parse(json, o));
+	EXPECT_TRUE(o.id == 7);
+	EXPECT_TRUE(o.paid);
+	EXPECT_EQ_SIZE_T(2, o.items.size());
+	EXPECT_TRUE(o.items[1].sku == "b");
+	EXPECT_TRUE(o.items[1].price && *o.items[1].price == 2.5);
+	EXPECT_FALSE(o.items[0].price.has_value());
+	EXPECT_EQ_SIZE_T(2, o.tags->size());
+	EXPECT_FALSE(o.discount.has_value());
+	EXPECT_FALSE(o.note.has_value());
+	EXPECT_TRUE(o.meta && o.meta->get_type() == lept_type::object);
+	EXPECT_TRUE(lept_gen_stringify(o) == "{\"id\":7,\"items\":[{\"count\":2,\"sku\":\"a\"},{\"count\":1,\"price\":2.5,\"sku\":\"b\"}],"
+		"\"meta\":{\"m\":1},\"paid\":true,\"tags\":[\"x\",\"y\"]}");
+
+	gen_order back;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_gen_parse(lept_gen_stringify(o), back));
+	EXPECT_TRUE(lept_gen_stringify(back) == lept_gen_stringify(o));
+
+	o.discount = 0.5;
+	o.default_.emplace();
+	o.default_->sku = "d";
+	o.default_->count = 0;
+	EXPECT_TRUE(lept_gen_stringify(o).rfind("{\"default\":{\"count\":0,\"sku\":\"d\"},\"discount\":0.5,\"id\":7,", 0) == 0);
+
+	/* required members and types are enforced */
+	EXPECT_EQ_INT(LEPT_PARSE_TYPE_MISMATCH, lept_gen_parse("{\"id\":1,\"paid\":false}", o));
+	EXPECT_EQ_INT(LEPT_PARSE_TYPE_MISMATCH, lept_gen_parse("{\"id\":\"1\",\"paid\":false,\"items\":[]}", o));
+	EXPECT_EQ_INT(LEPT_PARSE_TYPE_MISMATCH, lept_gen_parse("{\"id\":1,\"paid\":false,\"items\":[{\"sku\":\"a\"}]}", o));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_gen_parse("{\"id\":1,\"paid\":false,\"items\":[]}", o));
+	EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, lept_gen_parse("{\"id\":1,\"paid\":false,\"items\":[]} x", o));
+}
+
+static void test_schema()
+{
+	lept_schema s;
+	lept_schema_error err;
+	lept_value v;
+	EXPECT_EQ_INT(LEPT_SCHEMA_OK, s.compile(
+		"{\"type\":\"object\",\"required\":[\"id\",\"tags\"],\"properties\":{"
+		"\"id\":{\"type\":\"integer\",\"minimum\":1},"
+		"\"name\":{\"type\":\"string\",\"minLength\":2,\"maxLength\":4,\"pattern\":\"^[a-z]+$\"},"
+		"\"kind\":{\"enum\":[\"a\",[1,2],null]},"
+		"\"score\":{\"type\":[\"number\",\"null\"],\"exclusiveMaximum\":10},"
+		"\"tags\":{\"type\":\"array\",\"maxItems\":2,\"items\":{\"type\":\"string\"}}}}"));
+
+	EXPECT_EQ_INT(LEPT_SCHEMA_OK, s.validate("{\"id\":3,\"name\":\"ab\",\"kind\":[1,2],\"score\":9.5,\"tags\":[],\"x\":{}}"));
+	EXPECT_EQ_INT(LEPT_SCHEMA_OK, s.validate("{\"id\":3.0,\"kind\":null,\"score\":null,\"tags\":[\"t\"]}"));
+
+	EXPECT_EQ_INT(LEPT_SCHEMA_INVALID, s.validate("{\"id\":1.5,\"tags\":[]}", &err));
+	EXPECT_EQ_INT(LEPT_SCHEMA_TYPE, err.code);
+	EXPECT_TRUE(err.path == "/id");
+	EXPECT_EQ_INT(LEPT_SCHEMA_INVALID, s.validate("{\"id\":0,\"tags\":[]}", &err));
+	EXPECT_EQ_INT(LEPT_SCHEMA_MINIMUM, err.code);
+	EXPECT_EQ_INT(LEPT_SCHEMA_INVALID, s.validate("{\"id\":1,\"name\":\"abcde\",\"tags\":[]}", &err));
+	EXPECT_EQ_INT(LEPT_SCHEMA_MAX_LENGTH, err.code);
+	EXPECT_EQ_INT(LEPT_SCHEMA_INVALID, s.validate("{\"id\":1,\"name\":\"AB\",\"tags\":[]}", &err));
+	EXPECT_EQ_INT(LEPT_SCHEMA_PATTERN, err.code);
+	EXPECT_EQ_INT(LEPT_SCHEMA_INVALID, s.validate("{\"id\":1,\"kind\":[2,1],\"tags\":[]}", &err));
+	EXPECT_EQ_INT(LEPT_SCHEMA_ENUM, err.code);
+	EXPECT_EQ_INT(LEPT_SCHEMA_INVALID, s.validate("{\"id\":1,\"score\":10,\"tags\":[]}", &err));
+	EXPECT_EQ_INT(LEPT_SCHEMA_MAXIMUM, err.code);
+	EXPECT_EQ_INT(LEPT_SCHEMA_INVALID, s.validate("{\"id\":1}", &err));
+	EXPECT_EQ_INT(LEPT_SCHEMA_REQUIRED, err.code);
+	EXPECT_TRUE(err.path == "/tags");
+	EXPECT_EQ_INT(LEPT_SCHEMA_INVALID, s.validate("{\"id\":1,\"tags\":[\"a\",\"b\",\"c\"]}", &err));
+	EXPECT_EQ_INT(LEPT_SCHEMA_MAX_ITEMS, err.code);
+
+	/* rejected at the first violation, before the broken tail is scanned */
+	EXPECT_EQ_INT(LEPT_SCHEMA_INVALID, s.validate("{\"id\":1,\"tags\":[\"a\",7,", &err));
+	EXPECT_EQ_INT(LEPT_SCHEMA_TYPE, err.code);
+	EXPECT_TRUE(err.path == "/tags/1");
+	EXPECT_EQ_SIZE_T(20, err.offset);
+	EXPECT_EQ_INT(LEPT_SCHEMA_PARSE_ERROR, s.validate("{\"id\":1,\"tags\":[\"a\"", &err));
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, err.code);
+
+	v.set_integer(5);
+	EXPECT_EQ_INT(LEPT_SCHEMA_INVALID, s.parse("{\"id\":0,\"tags\":[]}", v));
+	EXPECT_EQ_TYPE(lept_type::integer, v.get_type());
+	EXPECT_EQ_INT(LEPT_SCHEMA_OK, s.parse("{\"id\":2,\"kind\":\"a\",\"tags\":[\"x\"],\"more\":[true]}", v));
+	EXPECT_TRUE(v.stringify() == "{\"id\":2,\"kind\":\"a\",\"more\":[true],\"tags\":[\"x\"]}");
+
+	/* the same input reads the same way as lept_value::parse() */
+	const char* big = "{\"id\":1,\"score\":9223372036854775808,\"tags\":[]}";
+	EXPECT_EQ_INT(LEPT_SCHEMA_PARSE_ERROR, s.validate(big, &err));
+	EXPECT_EQ_INT(LEPT_PARSE_NUMBER_TOO_BIG, err.code);
+	EXPECT_EQ_INT(LEPT_SCHEMA_PARSE_ERROR, s.parse(big, v, &err));
+	EXPECT_EQ_INT(LEPT_PARSE_NUMBER_TOO_BIG, v.parse(big));
+	const char* first = "{\"id\":2,\"tags\":[],\"id\":0,\"x\":1,\"x\":2}";
+	EXPECT_EQ_INT(LEPT_SCHEMA_OK, s.validate(first));
+	EXPECT_EQ_INT(LEPT_SCHEMA_OK, s.parse(first, v));
+	EXPECT_TRUE(v.stringify() == "{\"id\":2,\"tags\":[],\"x\":1}");
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse(first));
+	EXPECT_TRUE(v.stringify() == "{\"id\":2,\"tags\":[],\"x\":1}");
+	EXPECT_EQ_INT(LEPT_SCHEMA_INVALID, s.validate("{\"id\":0,\"tags\":[],\"id\":2}", &err));
+	EXPECT_EQ_INT(LEPT_SCHEMA_MINIMUM, err.code);
+
+	EXPECT_EQ_INT(LEPT_SCHEMA_BAD_SCHEMA, s.compile("{\"type\":\"float\"}"));
+	EXPECT_EQ_INT(LEPT_SCHEMA_BAD_SCHEMA, s.compile("{\"pattern\":\"(\"}"));
+	EXPECT_EQ_INT(LEPT_SCHEMA_OK, s.compile("false"));
+	EXPECT_EQ_INT(LEPT_SCHEMA_INVALID, s.validate("1"));
+}
+
+static int apply_patch(lept_value& doc, const char* patch, size_t* failed = nullptr)
+{
+	lept_value p;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, p.parse(patch));
+	return lept_apply_patch(doc, p, failed);
+}
+
+static void test_patch()
+{
+	lept_value doc;
+	size_t failed;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, doc.parse("{\"a\":{\"b\":[1,2,3]},\"c\":\"x\",\"d~/e\":null}"));
+
+	EXPECT_EQ_INT(LEPT_PATCH_OK, apply_patch(doc,
+		"[{\"op\":\"add\",\"path\":\"/a/b/1\",\"value\":9},"
+		"{\"op\":\"add\",\"path\":\"/a/b/-\",\"value\":{\"k\":true}},"
+		"{\"op\":\"remove\",\"path\":\"/d~0~1e\"},"
+		"{\"op\":\"replace\",\"path\":\"/c\",\"value\":[]},"
+		"{\"op\":\"move\",\"from\":\"/a/b/0\",\"path\":\"/c/0\"},"
+		"{\"op\":\"copy\",\"from\":\"/a/b/2\",\"path\":\"/n\"},"
+		"{\"op\":\"test\",\"path\":\"/n\",\"value\":3.0}]"));
+	EXPECT_TRUE(doc.stringify() == "{\"a\":{\"b\":[9,2,3,{\"k\":true}]},\"c\":[1],\"n\":3}");
+
+	/* any failure rolls back every earlier operation */
+	std::string before = doc.stringify();
+	EXPECT_EQ_INT(LEPT_PATCH_TEST_FAILED, apply_patch(doc,
+		"[{\"op\":\"remove\",\"path\":\"/a/b/1\"},"
+		"{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/z\"},"
+		"{\"op\":\"add\",\"path\":\"/z/b/0\",\"value\":0},"
+		"{\"op\":\"replace\",\"path\":\"\",\"value\":5},"
+		"{\"op\":\"test\",\"path\":\"\",\"value\":6}]", &failed));
+	EXPECT_EQ_SIZE_T(4, failed);
+	EXPECT_TRUE(doc.stringify() == before);
+
+	EXPECT_EQ_INT(LEPT_PATCH_PATH_NOT_FOUND, apply_patch(doc,
+		"[{\"op\":\"move\",\"from\":\"/c\",\"path\":\"/a/x/y\"}]", &failed));
+	EXPECT_EQ_SIZE_T(0, failed);
+	EXPECT_TRUE(doc.stringify() == before);
+	EXPECT_EQ_INT(LEPT_PATCH_PATH_NOT_FOUND, apply_patch(doc, "[{\"op\":\"add\",\"path\":\"/a/b/5\",\"value\":1}]"));
+	EXPECT_EQ_INT(LEPT_PATCH_PATH_NOT_FOUND, apply_patch(doc, "[{\"op\":\"remove\",\"path\":\"/a/b/01\"}]"));
+	EXPECT_EQ_INT(LEPT_PATCH_INVALID_OPERATION, apply_patch(doc, "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/a/b/0\"}]"));
+	EXPECT_EQ_INT(LEPT_PATCH_INVALID_OPERATION, apply_patch(doc, "[{\"op\":\"frob\",\"path\":\"/a\"}]"));
+	EXPECT_EQ_INT(LEPT_PATCH_INVALID_OPERATION, apply_patch(doc, "[{\"op\":\"add\",\"path\":\"/a\"}]"));
+	EXPECT_EQ_INT(LEPT_PATCH_INVALID_POINTER, apply_patch(doc, "[{\"op\":\"remove\",\"path\":\"a\"}]"));
+	EXPECT_EQ_INT(LEPT_PATCH_INVALID_POINTER, apply_patch(doc, "[{\"op\":\"remove\",\"path\":\"/~2\"}]"));
+	EXPECT_TRUE(doc.stringify() == before);
+
+	/* move relinks the value instead of copying it */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, doc.parse("{\"s\":\"a string long enough to live on the heap\"}"));
+	const char* data = doc["s"].get_string().data();
+	EXPECT_EQ_INT(LEPT_PATCH_OK, apply_patch(doc, "[{\"op\":\"move\",\"from\":\"/s\",\"path\":\"/t\"}]"));
+	EXPECT_TRUE(doc["t"].get_string().data() == data);
+
+	/* the whole document can be replaced */
+	EXPECT_EQ_INT(LEPT_PATCH_OK, apply_patch(doc, "[{\"op\":\"add\",\"path\":\"\",\"value\":[1]},{\"op\":\"add\",\"path\":\"/0\",\"value\":0}]"));
+	EXPECT_TRUE(doc.stringify() == "[0,1]");
+}
+
+static void test_diff_case(const char* from, const char* to, size_t ops)
+{
+	lept_value a, b;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, a.parse(from));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, b.parse(to));
+	lept_value patch = lept_diff(a, b);
+	EXPECT_EQ_SIZE_T(ops, patch.get_array_size());
+	EXPECT_EQ_INT(LEPT_PATCH_OK, lept_apply_patch(a, patch));
+	EXPECT_TRUE(a.stringify() == b.stringify());
+}
+
+static void test_diff()
+{
+	test_diff_case("{\"a\":[1,2,3],\"b\":{\"c\":1}}", "{\"a\":[1,2,3],\"b\":{\"c\":1}}", 0);
+	test_diff_case("1", "1.0", 0);
+	test_diff_case("1", "\"1\"", 1);
+	test_diff_case("{\"a\":1,\"b\":2}", "{\"b\":3,\"c\":4}", 3);
+	test_diff_case("{\"x\":{\"y\":{\"z\":[1]}}}", "{\"x\":{\"y\":{\"z\":[1,2]}}}", 1);
+	test_diff_case("{\"a/b\":1,\"~\":2}", "{\"a/b\":2}", 2);
+	test_diff_case("[1,2,3,4,5,6,7,8]", "[1,2,3,9,4,5,6,7,8]", 1);
+	test_diff_case("[1,2,3,4,5,6,7,8]", "[1,2,4,5,6,8]", 2);
+	test_diff_case("[1,2,3]", "[3,1,2]", 2);
+	test_diff_case("[1,2,3]", "[]", 3);
+	test_diff_case("[]", "[1,2]", 2);
+	test_diff_case("[{\"id\":1,\"v\":\"a\"},{\"id\":2,\"v\":\"b\"}]", "[{\"id\":1,\"v\":\"a\"},{\"id\":2,\"v\":\"c\"}]", 1);
+	test_diff_case("[1,{\"k\":[true]},\"s\",null]", "[\"t\",{\"k\":[false]},null,5]", 4);
+
+	/* too large to align: compared position by position */
+	lept_value::array_t big_a, big_b;
+	for (int i = 0; i < 3000; i++) {
+		big_a.push_back(lept_value(i));
+		big_b.push_back(lept_value(i % 2 ? i : -i - 1));
+	}
+	big_b.push_back(lept_value(true));
+	lept_value x(big_a), y(big_b);
+	lept_value big = lept_diff(x, y);
+	EXPECT_EQ_SIZE_T(1501, big.get_array_size());
+	EXPECT_EQ_INT(LEPT_PATCH_OK, lept_apply_patch(x, big));
+	EXPECT_TRUE(x.stringify() == y.stringify());
+
+	lept_value patch = lept_diff(lept_value(1), lept_value("x"));
+	EXPECT_TRUE(patch.stringify() == "[{\"op\":\"replace\",\"path\":\"\",\"value\":\"x\"}]");
+}
+
+static void test_equal_hash()
+{
+	lept_value a, b;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, a.parse("{\"x\":[1,2.5,\"s\",null,true],\"y\":{\"z\":-0}}"));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, b.parse("{ \"y\" : {\"z\":0.0}, \"x\":[1.0,2.5,\"s\",null,true]}"));
+	EXPECT_TRUE(a == b);
+	EXPECT_TRUE(lept_hash(a) == lept_hash(b));
+	EXPECT_TRUE(std::hash<lept_value>()(a) == lept_hash(a));
+
+	b["x"][4] = lept_value(false);
+	EXPECT_TRUE(a != b);
+	EXPECT_FALSE(lept_hash(a) == lept_hash(b));
+	EXPECT_FALSE(lept_value(1) == lept_value("1"));
+	EXPECT_FALSE(lept_value(lept_value::array_t{ 1, 2 }) == lept_value(lept_value::array_t{ 2, 1 }));
+	EXPECT_FALSE(lept_hash(lept_value(lept_value::array_t{ 1, 2 })) == lept_hash(lept_value(lept_value::array_t{ 2, 1 })));
+	EXPECT_FALSE(lept_hash(lept_value("")) == lept_hash(lept_value()));
+
+	/* the hash is fixed, not seeded per process */
+	lept_value known;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, known.parse("{\"a\":[1,2.5,\"x\",null,true],\"b\":{}}"));
+	EXPECT_TRUE(lept_hash(known) == (size_t)0x66e53ea08de31796ULL);
+	EXPECT_TRUE(lept_hash(lept_value("")) == (size_t)0x4fe378a10b3a78d9ULL);
+	EXPECT_TRUE(lept_hash(lept_value("abc")) == lept_hash(lept_value(std::string("abc"))));
+
+	lept_hash_cache cache;
+	EXPECT_TRUE(cache(a) == lept_hash(a));
+	EXPECT_EQ_SIZE_T(9, cache.size());
+	EXPECT_TRUE(cache(a["y"]) == lept_hash(a["y"]));
+	EXPECT_EQ_SIZE_T(9, cache.size());
+
+	std::unordered_map<lept_value, int> seen;
+	seen[a] = 1;
+	EXPECT_EQ_SIZE_T(1, seen.count(lept_value(a)));
+}
+
+static void test_copy_on_write()
+{
+	lept_value a;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, a.parse("{\"list\":[1,2,{\"deep\":true}],\"name\":\"n\",\"other\":{\"x\":1}}"));
+	const lept_value& ca = a;
+
+	/* a copy is deep, and a reference taken before it does not alias it */
+	lept_value& name = a["name"];
+	lept_value c = a;
+	const lept_value& cc = c;
+	EXPECT_FALSE(&ca.get_object() == &cc.get_object());
+	EXPECT_FALSE(&ca["list"].get<lept_value::array_t>() == &cc["list"].get<lept_value::array_t>());
+	name = lept_value("z");
+	EXPECT_TRUE(cc["name"].get_string() == "n");
+	name = lept_value("n");
+
+	/* shared handles share containers until one side is written */
+	lept_value b = a.share();
+	const lept_value& cb = b;
+	EXPECT_TRUE(&ca.get_object() == &cb.get_object());
+	EXPECT_TRUE(&ca["list"].get<lept_value::array_t>() == &cb["list"].get<lept_value::array_t>());
+
+	b["list"][2]["deep"] = lept_value(false);
+	EXPECT_FALSE(&ca.get_object() == &cb.get_object());
+	EXPECT_TRUE(ca["list"][2]["deep"].get_boolean());
+	EXPECT_FALSE(cb["list"][2]["deep"].get_boolean());
+	/* only the path to the change was cloned */
+	EXPECT_TRUE(&ca["other"].get_object() == &cb["other"].get_object());
+	EXPECT_TRUE(b.stringify() == "{\"list\":[1,2,{\"deep\":false}],\"name\":\"n\",\"other\":{\"x\":1}}");
+	EXPECT_TRUE(a.stringify() == "{\"list\":[1,2,{\"deep\":true}],\"name\":\"n\",\"other\":{\"x\":1}}");
+
+	/* an unshared container is written in place */
+	const lept_value::object_t* before = &cb.get_object();
+	b["name"] = lept_value("m");
+	EXPECT_TRUE(before == &cb.get_object());
+
+	lept_value d = a["list"].share();
+	d.get<lept_value::array_t>().push_back(lept_value(4));
+	EXPECT_EQ_SIZE_T(3, ca["list"].get_array_size());
+	EXPECT_EQ_SIZE_T(4, d.get_array_size());
+
+	lept_value e = a.share();
+	e.compact();
+	EXPECT_TRUE(e == a);
+	EXPECT_FALSE(&e.get<lept_value::object_t>() == &ca.get_object());
+}
+
+static void test_shared_document()
+{
+	lept_shared_document doc(lept_value(lept_value::object_t{ { "version", lept_value(0) } }));
+	lept_shared_document::snapshot first = doc.acquire();
+	EXPECT_EQ_INT(0, (*first)["version"].get_integer());
+
+	doc.publish(lept_value(lept_value::object_t{ { "version", lept_value(1) }, { "data", lept_value(lept_value::array_t{ "x" }) } }));
+	lept_shared_document::snapshot second = doc.acquire();
+	lept_shared_document::snapshot copy = second;
+	EXPECT_EQ_INT(0, (*first)["version"].get_integer());
+	EXPECT_EQ_INT(1, copy->get_object().at("version").get_integer());
+	first.release();
+	EXPECT_FALSE((bool)first);
+
+	/* readers only ever see whole versions, in order */
+	std::atomic<bool> stop(false);
+	std::atomic<int> errors(0);
+	std::vector<std::thread> readers;
+	for (int t = 0; t < 4; t++)
+		readers.emplace_back([&] {
+			int last = 0;
+			while (!stop.load()) {
+				auto snap = doc.acquire();
+				const lept_value& v = *snap;
+				int version = v["version"].get_integer();
+				if (version < last || v["data"].get_array_size() != (size_t)version % 7)
+					errors++;
+				last = version;
+			}
+		});
+	for (int version = 1; version <= 2000; version++) {
+		lept_value::array_t data((size_t)version % 7, lept_value("x"));
+		doc.publish(lept_value(lept_value::object_t{ { "version", lept_value(version) }, { "data", lept_value(std::move(data)) } }));
+	}
+	/* enough acquisitions of one version to wrap the 16-bit count */
+	for (int i = 0; i < 70000; i++)
+		doc.acquire();
+	stop = true;
+	for (auto& th : readers)
+		th.join();
+	EXPECT_EQ_INT(0, errors.load());
+	EXPECT_EQ_INT(2000, (*doc.acquire())["version"].get_integer());
+	EXPECT_EQ_INT(1, (*second)["version"].get_integer());
+}
+
+static void test_stringify_parallel()
+{
+	lept_value::array_t items;
+	for (int i = 0; i < 1000; i++)
+		items.push_back(lept_value{ lept_value(i), lept_value("s" + std::to_string(i)), lept_value(i * 0.5) });
+	lept_value arr(std::move(items));
+	lept_value::object_t members;
+	for (int i = 0; i < 500; i++)
+		members["k" + std::to_string(i)] = arr[i];
+	lept_value obj(std::move(members));
+
+	for (unsigned threads : { 0u, 1u, 3u, 64u }) {
+		EXPECT_TRUE(arr.stringify_parallel(threads) == arr.stringify());
+		EXPECT_TRUE(obj.stringify_parallel(threads) == obj.stringify());
+	}
+	lept_value small;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, small.parse("[[]]"));
+	EXPECT_TRUE(small.stringify_parallel(4) == "[[]]");
+	EXPECT_TRUE(lept_value(lept_value::array_t()).stringify_parallel(4) == "[]");
+	EXPECT_TRUE(lept_value("x").stringify_parallel(4) == "\"x\"");
+
+#ifdef LEPT_HAVE_WRITEV
+	FILE* fp = tmpfile();
+	EXPECT_TRUE(fp != nullptr);
+	if (fp) {
+		EXPECT_EQ_INT(LEPT_STRINGIFY_OK, obj.stringify_parallel_fd(fileno(fp), 4));
+		std::string expect = obj.stringify(), got(expect.size() + 1, '\0');
+		rewind(fp);
+		got.resize(fread(&got[0], 1, got.size(), fp));
+		EXPECT_TRUE(got == expect);
+		fclose(fp);
+	}
+	EXPECT_EQ_INT(LEPT_STRINGIFY_IO_ERROR, arr.stringify_parallel_fd(-1, 4));
+	int pipefd[2];
+	EXPECT_EQ_INT(0, pipe(pipefd));
+	fcntl(pipefd[1], F_SETFL, O_NONBLOCK);
+	lept_value big(lept_value::array_t{ lept_value(std::string(1 << 20, 'x')) });
+	EXPECT_EQ_INT(LEPT_STRINGIFY_IO_ERROR, big.stringify_parallel_fd(pipefd[1], 2));
+	close(pipefd[0]);
+	close(pipefd[1]);
+#endif
+}
+
+static void test_utf8()
+{
+	static const char* valid[] = {
+		"", "ascii only", "\xC2\xA2", "\xE2\x82\xAC", "\xF0\x90\x8D\x88", "\xED\x9F\xBF",
+		"\xEF\xBF\xBF", "\xF4\x8F\xBF\xBF", "\xE4\xB8\xAD\xE6\x96\x87\xE5\xAD\x97\xE7\xAC\xA6"
+	};
+	static const char* invalid[] = {
+		"\x80", "\xBF", "\xC0\xAF", "\xC1\xBF", "\xC2", "\xC2\x41", "\xE0\x80\xAF", "\xE0\x9F\xBF",
+		"\xED\xA0\x80", "\xED\xBF\xBF", "\xE2\x82", "\xF0\x8F\xBF\xBF", "\xF4\x90\x80\x80",
+		"\xF5\x80\x80\x80", "\xFF", "\xF0\x90\x8D", "\xC2\xA2\xA2"
+	};
+	/* shift each case across the 16-byte block boundaries */
+	for (size_t pad = 0; pad < 34; pad++) {
+		std::string prefix(pad, 'a');
+		for (const char* s : valid) {
+			std::string t = prefix + s + "z";
+			EXPECT_TRUE(lept_validate_utf8(t.data(), t.size()));
+			t.pop_back();
+			EXPECT_TRUE(lept_validate_utf8(t.data(), t.size()));
+		}
+		for (const char* s : invalid) {
+			std::string t = prefix + s + "z";
+			EXPECT_FALSE(lept_validate_utf8(t.data(), t.size()));
+			t.pop_back();
+			EXPECT_FALSE(lept_validate_utf8(t.data(), t.size()));
+		}
+	}
+
+	lept_value v;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse("[\"\xE4\xB8\xAD\\u00e9\",\"x\"]", LEPT_PARSE_STRICT_UTF8));
+	EXPECT_TRUE(v[0].get_string() == "\xE4\xB8\xAD\xC3\xA9");
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_UTF8, v.parse("[\"\xED\xA0\x80\"]", LEPT_PARSE_STRICT_UTF8));
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_UTF8, v.parse("{\"\xC0\xAF\":1}", LEPT_PARSE_STRICT_UTF8));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse("[\"\xED\xA0\x80\"]", 0u));
+
+	/* checked run by run around escapes, and escapes must not make
+	 * ill-formed UTF-8 either */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse("\"\xC3\xA9\\n\xE4\xB8\xAD\\u00e9\"", LEPT_PARSE_STRICT_UTF8));
+	EXPECT_TRUE(v.get_string() == "\xC3\xA9\n\xE4\xB8\xAD\xC3\xA9");
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_UTF8, v.parse("\"ok\\n\xC3\"", LEPT_PARSE_STRICT_UTF8));
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_UTF8, v.parse("\"\xC3\\n\xA9\"", LEPT_PARSE_STRICT_UTF8));
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_UNICODE_SURROGATE, v.parse("\"\\uDC00\"", LEPT_PARSE_STRICT_UTF8));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse("\"\\uD834\\uDD1E\"", LEPT_PARSE_STRICT_UTF8));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse("\"\\uDC00\"", 0u));
+}
+
+static void test_lazy_numbers()
+{
+	const char* json = "[1.10,-0,2.5E+10,12345678901234567890123,1e400,{\"d\":3.14159265358979323846264338327,\"n\":42}]";
+	lept_value v;
+	EXPECT_EQ_INT(LEPT_PARSE_NUMBER_TOO_BIG, v.parse(json, LEPT_PARSE_LAZY_NUMBERS));
+
+	json = "[1.10,-0,2.5E+10,123456789012345678,{\"d\":3.14159265358979323846264338327,\"n\":42}]";
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse(json, LEPT_PARSE_LAZY_NUMBERS));
+	/* unread and unchanged numbers come back as written */
+	EXPECT_TRUE(v.stringify() == json);
+	EXPECT_EQ_DOUBLE(1.1, v[0].get_number());
+	EXPECT_EQ_INT(0, v[1].get_integer());
+	EXPECT_EQ_DOUBLE(2.5e10, v[2].get_number());
+	EXPECT_EQ_INT(42, v[4]["n"].get_integer());
+	EXPECT_TRUE(v.stringify() == json);
+	/* so does const get<T>(), which converts by value */
+	const lept_value& cv = v;
+	EXPECT_EQ_DOUBLE(2.5e10, cv[2].get<double>());
+	EXPECT_EQ_INT(42, cv[4]["n"].get<int>());
+	EXPECT_EQ_DOUBLE(3.14159265358979323846264338327, cv[4]["d"].get<const double>());
+	EXPECT_TRUE(v.stringify() == json);
+
+	lept_value eager;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, eager.parse(json));
+	EXPECT_TRUE(v == eager);
+	EXPECT_EQ_SIZE_T(lept_hash(eager), lept_hash(v));
+
+	lept_value copy = v;
+	copy[4]["n"].get<int>() += 1;
+	EXPECT_EQ_INT(43, copy[4]["n"].get_integer());
+	copy[0] = lept_value(2.0);
+	EXPECT_TRUE(copy.stringify() == "[2,-0,2.5E+10,123456789012345678,{\"d\":3.14159265358979323846264338327,\"n\":43}]");
+	EXPECT_TRUE(v.stringify() == json);
+
+	/* long decimals keep every digit; integers past nine digits are numbers,
+	 * so get_integer() never truncates what stringify() writes */
+	json = "[0.1000000000000000000000000000000000000000001,-1.5e-300,1234567890,-999999999]";
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse(json, LEPT_PARSE_LAZY_NUMBERS));
+	EXPECT_TRUE(v.stringify() == json);
+	EXPECT_EQ_INT(lept_type::number, v[2].get_type());
+	EXPECT_EQ_DOUBLE(1234567890.0, v[2].get_number());
+	EXPECT_EQ_INT(-999999999, v[3].get_integer());
+	EXPECT_TRUE(v.memory_usage().strings >= 44);
+	copy = v;
+	EXPECT_TRUE(copy == v);
+	EXPECT_TRUE(copy.stringify() == json);
+
+	/* the first read converts and the rest reuse it, from any thread */
+	const lept_value& first = cv[0];
+	double got[4];
+	std::vector<std::thread> readers;
+	for (int t = 0; t < 4; t++)
+		readers.emplace_back([&first, &got, t] { got[t] = first.get_number(); });
+	for (auto& th : readers)
+		th.join();
+	for (int t = 0; t < 4; t++)
+		EXPECT_EQ_DOUBLE(0.1, got[t]);
+	EXPECT_EQ_DOUBLE(0.1, first.get_number());
+	EXPECT_TRUE(v.stringify() == json);
+}
+
+static void test_parse_borrowed()
+{
+	const char* json = "{\"plain\":\"abc\",\"esc\":\"a\\nb\\u00e9\",\"list\":[\"x\",\"\\\"q\\\"\"]}";
+	lept_value owned;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, owned.parse(json));
+
+	std::string input(json);
+	lept_value v;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse_borrowed(input.c_str()));
+	const lept_value& cv = v;
+	/* escape-free strings point into the input */
+	EXPECT_TRUE(cv["plain"].get_string_view().data() == input.c_str() + input.find("abc"));
+	EXPECT_TRUE(cv["esc"].get_string_view() == "a\nb\xC3\xA9");
+	EXPECT_TRUE(v == owned);
+	EXPECT_TRUE(v.stringify() == owned.stringify());
+	EXPECT_EQ_SIZE_T(lept_hash(owned), lept_hash(v));
+	EXPECT_EQ_SIZE_T(0, lept_value(v["plain"]).memory_usage().strings);
+
+	/* a copy shares the borrowed text; get_string() takes its own copy */
+	lept_value copy = cv["list"];
+	EXPECT_TRUE(copy[0].get_string() == "x");
+	EXPECT_FALSE(copy[0].get_string().data() == input.c_str() + input.find("x\""));
+
+	/* const reads on several threads leave the value itself alone */
+	const lept_value& plain = cv["plain"];
+	const std::string* seen[4];
+	std::vector<std::thread> readers;
+	for (int t = 0; t < 4; t++)
+		readers.emplace_back([&plain, &seen, t] { seen[t] = &plain.get_string(); });
+	for (auto& th : readers)
+		th.join();
+	EXPECT_TRUE(*seen[0] == "abc");
+	for (int t = 1; t < 4; t++)
+		EXPECT_TRUE(seen[t] == seen[0]);
+	EXPECT_TRUE(plain.get_string_view().data() == input.c_str() + input.find("abc"));
+	EXPECT_TRUE(&plain.get<std::string>() == seen[0]);
+
+	std::vector<char> buf(json, json + strlen(json) + 1);
+	lept_value in;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, in.parse_insitu(buf.data()));
+	EXPECT_TRUE(in == owned);
+	const lept_value& cin = in;
+	/* unescaped over the source text */
+	const char* esc = cin["esc"].get_string_view().data();
+	EXPECT_TRUE(esc > buf.data() && esc < buf.data() + buf.size());
+	EXPECT_TRUE(cin["list"][1].get_string_view() == "\"q\"");
+
+	std::vector<char> bad = { '[', '"', '\\', 'x', '"', ']', '\0' };
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_STRING_ESCAPE, in.parse_insitu(bad.data()));
+}
+
+static void test_pool()
+{
+	lept_pool_trim();
+	EXPECT_EQ_SIZE_T(0, lept_pool_cached());
+	void* a = lept_pool_allocate(100);
+	lept_pool_deallocate(a, 100);
+	EXPECT_EQ_SIZE_T(128, lept_pool_cached());
+	/* same size class */
+	void* b = lept_pool_allocate(120);
+	EXPECT_TRUE(a == b);
+	EXPECT_EQ_SIZE_T(0, lept_pool_cached());
+	lept_pool_deallocate(b, 120);
+
+	void* big = lept_pool_allocate(LEPT_POOL_MAX_BLOCK + 1);
+	lept_pool_deallocate(big, LEPT_POOL_MAX_BLOCK + 1);
+	EXPECT_EQ_SIZE_T(128, lept_pool_cached());
+
+	/* freed on another thread, cached there */
+	void* c = lept_pool_allocate(40);
+	size_t other = 0;
+	std::thread t([&] { lept_pool_deallocate(c, 40); other = lept_pool_cached(); });
+	t.join();
+	EXPECT_EQ_SIZE_T(64, other);
+
+	std::vector<int, lept_pool_allocator<int>> v(1000, 7);
+	EXPECT_EQ_INT(7000, std::accumulate(v.begin(), v.end(), 0));
+
+#ifdef LEPT_POOL
+	lept_pool_trim();
+	{
+		lept_value doc;
+		EXPECT_EQ_INT(LEPT_PARSE_OK, doc.parse("[{\"a\":[1,2,3]},{\"b\":{\"c\":[]}}]"));
+	}
+	size_t cached = lept_pool_cached();
+	EXPECT_TRUE(cached > 0);
+	{
+		lept_value doc;
+		EXPECT_EQ_INT(LEPT_PARSE_OK, doc.parse("[{\"a\":[1,2,3]},{\"b\":{\"c\":[]}}]"));
+		/* the second parse is served from the pool */
+		EXPECT_TRUE(lept_pool_cached() < cached);
+	}
+	EXPECT_EQ_SIZE_T(cached, lept_pool_cached());
+#endif
+	lept_pool_trim();
+}
+
+static void test_path_case(const char* expr, const char* json, const char* expect)
+{
+	lept_path p;
+	EXPECT_EQ_INT(LEPT_PATH_OK, p.compile(expr));
+	lept_value doc;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, doc.parse(json));
+
+	std::vector<const lept_value*> hits;
+	p.select(doc, hits);
+	lept_value::array_t found;
+	for (auto h : hits)
+		found.push_back(*h);
+EXPECT_TRUE(lept_value(found).stringify() == expect);
+
+	std::vector<lept_value> values;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, p.select(json, values));
+	EXPECT_TRUE(lept_value(lept_value::array_t(values.begin(), values.end())).stringify() == expect);
+}
+
+static void test_path()
+{
+	/* members in key order, so both modes agree */
+	const char* store = "{\"store\":{\"bicycle\":{\"color\":\"red\",\"price\":19.5},\"book\":["
+		"{\"price\":8.5,\"tags\":[\"x\"],\"title\":\"A\"},"
+		"{\"isbn\":\"1-2\",\"price\":12,\"title\":\"B\"},"
+		"{\"isbn\":\"3-4\",\"price\":22.5,\"title\":\"C\"}]}}";
+	test_path_case("$", "[1]", "[[1]]");
+	test_path_case("$.store.book[1].title", store, "[\"B\"]");
+	test_path_case("$['store'][\"bicycle\"].color", store, "[\"red\"]");
+	test_path_case("$.store.book[*].title", store, "[\"A\",\"B\",\"C\"]");
+	test_path_case("$.store.book[5].title", store, "[]");
+	test_path_case("$.store.*.price", store, "[19.5]");
+	test_path_case("$..isbn", store, "[\"1-2\",\"3-4\"]");
+	test_path_case("$.store..price", store, "[19.5,8.5,12,22.5]");
+	test_path_case("$.store.book[?(@.price > 10)].title", store, "[\"B\",\"C\"]");
+	test_path_case("$.store.book[?(@.isbn)].price", store, "[12,22.5]");
+	test_path_case("$.store.book[?(@.title == 'A')].tags[0]", store, "[\"x\"]");
+	test_path_case("$.store.book[?(@.price <= 12)]..title", store, "[\"A\",\"B\"]");
+	test_path_case("$..a", "{\"a\":{\"a\":1}}", "[{\"a\":1},1]");
+	test_path_case("$..*", "[[1],2]", "[[1],1,2]");
+	test_path_case("$[?(@ != null)]", "[null,0,false]", "[0,false]");
+	test_path_case("$.m[?(@ > 1)]", "{\"m\":{\"a\":1,\"b\":2,\"c\":3}}", "[2,3]");
+	test_path_case("$..book[?(@.price > 20)].title", store, "[\"C\"]");
+	test_path_case("$..a..b", "{\"a\":{\"a\":{\"b\":1}}}", "[1]");
+	test_path_case("$..*..*", "[[[1]]]", "[[1],1]");
+	test_path_case("$..*[?(@ > 1)]", "{\"a\":[1,{\"b\":2}],\"c\":[3]}", "[2,3]");
+	test_path_case("$[?(@ > 2147483647)]", "[2147483648,1,-3000000000,3000000000]", "[2147483648,3000000000]");
+	test_path_case("$[?(@ == 9007199254740993)]", "[9007199254740992,1]", "[9007199254740992]");
+
+	lept_path p;
+	size_t at;
+	EXPECT_EQ_INT(LEPT_PATH_INVALID, p.compile("store", &at));
+	EXPECT_EQ_SIZE_T(0, at);
+	EXPECT_EQ_INT(LEPT_PATH_INVALID, p.compile("$.a[?(@.b >)]", &at));
+	EXPECT_EQ_SIZE_T(11, at);
+	EXPECT_EQ_INT(LEPT_PATH_INVALID, p.compile("$.a[1", &at));
+	EXPECT_EQ_INT(LEPT_PATH_INVALID, p.compile("$[99999999999999999999999]"));
+
+	std::vector<lept_value> values;
+	EXPECT_EQ_INT(LEPT_PATH_OK, p.compile("$.a"));
+	/* subtrees off the path are skipped but still checked */
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, p.select("{\"b\":[1 2],\"a\":1}", values));
+	EXPECT_EQ_SIZE_T(0, values.size());
+
+	/* a filter builds each element on its own, so the matches before an
+	 * error are kept */
+	EXPECT_EQ_INT(LEPT_PATH_OK, p.compile("$[?(@ > 1)]"));
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, p.select("[1,2,3,x]", values));
+	EXPECT_EQ_SIZE_T(2, values.size());
+}
+
+static void test_parse_mask()
+{
+	const char* json = "{\"id\":7,\"user\":{\"name\":\"n\",\"pw\":\"x\",\"tags\":[1,{\"a\":[]}]},"
+		"\"items\":[{\"sku\":\"a\",\"qty\":1},{\"qty\":2},{\"sku\":\"b\",\"junk\":[[\"]\\\"\"],{}]}],"
+		"\"blob\":{\"deep\":[[[{\"x\":\"}\"}]]]},\"n\":-1.5e3,\"t\":true}";
+	lept_value v;
+	lept_field_mask mask{ "id", "user.name", "user.tags", "items.sku", "t" };
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse(json, mask));
+	EXPECT_TRUE(v.stringify() == "{\"id\":7,\"items\":[{\"sku\":\"a\"},{},{\"sku\":\"b\"}],\"t\":true,"
+		"\"user\":{\"name\":\"n\",\"tags\":[1,{\"a\":[]}]}}");
+
+	/* a path ending higher up keeps everything below it */
+	lept_field_mask wide{ "user.name", "user" };
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse(json, wide));
+	EXPECT_EQ_SIZE_T(3, v["user"].get_object_size());
+
+	lept_field_mask keys;
+	keys.add(std::vector<std::string>{ "a.b" });
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse("{\"a.b\":1,\"a\":{\"b\":2}}", keys));
+	EXPECT_TRUE(v.stringify() == "{\"a.b\":1}");
+
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_QUOTATION_MARK, v.parse("{\"id\":1,\"skip\":[\"open]}", mask));
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, v.parse("{\"skip\":[[1]}", mask));
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, v.parse("{\"skip\":,\"id\":1}", mask));
+
+	/* members left out are still checked, with the codes parse() gives */
+	lept_field_mask only_a{ "a" };
+	const char* bad[] = {
+		"{\"a\":1,\"b\":tru}", "{\"b\":[1 2],\"a\":1}", "{\"b\":{\"k\" 1}}", "{\"b\":\"\\x\"}",
+		"{\"b\":01}", "{\"b\":1e400}", "{\"b\":[\"\\uD800\"]}", "{\"b\":\"\x01\"}",
+	};
+	for (const char* d : bad)
+		EXPECT_EQ_INT(lept_value().parse(d), v.parse(d, only_a));
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, v.parse("{\"a\":1,\"b\":tru}", only_a));
+}
+
+static void test_validate()
+{
+	const char* docs[] = {
+		"null", " [1, -2.5e-3, \"a\\u00e9\", {\"k\": [true, false]}] ",
+		"\"a string longer than sixteen bytes with \\\" an escape\"",
+		"9223372036854775807", "-9223372036854775808", "1.7976931348623157e308", "1e-400",
+	};
+	lept_value v;
+	for (const char* d : docs) {
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_validate(d));
+		EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse(d));
+	}
+
+	/* same verdict as parse(), without building anything */
+	const char* bad[] = {
+		"", "[1,]", "{\"a\" 1}", "[1] x", "\"\\uD800\"", "[\"open",
+		"9223372036854775808", "-9223372036854775809", "1e400", "[0, -1e309]", "\"\\x\"",
+	};
+	for (const char* d : bad)
+		EXPECT_EQ_INT(v.parse(d), lept_validate(d));
+	EXPECT_EQ_INT(LEPT_PARSE_NUMBER_TOO_BIG, lept_validate("1e400"));
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_STRING_ESCAPE, lept_validate("\"\\x\""));
+
+	size_t offset = 0;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_validate("{\"a\":[1,2]}", &offset));
+	EXPECT_EQ_SIZE_T(11, offset);
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_validate("{\"a\":[1,?]}", &offset));
+	EXPECT_EQ_SIZE_T(8, offset);
+
+	/* nesting is capped rather than recursed into until the stack runs out */
+	std::string deep(LEPT_PARSE_MAX_DEPTH, '[');
+	deep.append(LEPT_PARSE_MAX_DEPTH, ']');
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_validate(deep));
+	deep = std::string(1000000, '[') + std::string(1000000, ']');
+	EXPECT_EQ_INT(LEPT_PARSE_TOO_DEEP, lept_validate(deep, &offset));
+	EXPECT_EQ_SIZE_T(LEPT_PARSE_MAX_DEPTH, offset);
+	lept_reader r(deep);
+	EXPECT_EQ_INT(LEPT_PARSE_TOO_DEEP, r.read_value(v));
+	EXPECT_EQ_INT(LEPT_PARSE_TOO_DEEP, lept_validate("{\"a\":" + std::string(LEPT_PARSE_MAX_DEPTH, '[')));
+
+	/* parse() applies the same cap, to built and skipped values alike */
+	EXPECT_EQ_INT(LEPT_PARSE_TOO_DEEP, v.parse(deep));
+	EXPECT_EQ_INT(LEPT_PARSE_TOO_DEEP, v.parse_borrowed(deep.c_str()));
+	std::string shallow(LEPT_PARSE_MAX_DEPTH, '[');
+	shallow.append(LEPT_PARSE_MAX_DEPTH, ']');
+	EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse(shallow));
+	std::string nested = "{\"a\":" + shallow + "}";
+	EXPECT_EQ_INT(lept_validate(nested), v.parse(nested));
+	EXPECT_EQ_INT(LEPT_PARSE_TOO_DEEP, v.parse(nested, lept_field_mask{ "b" }));
+}
+
+#ifdef LEPT_ASYNC
+/* Hands out data step bytes per read.  Unless ready, each read suspends
+ * until pump() delivers it, as an event loop would when bytes arrive. */
+struct test_async_source
+{
+	std::string data;
+	size_t step;
+	bool ready;
+	size_t pos = 0;
+	std::coroutine_handle<> waiting = nullptr;
+
+	struct read_op
+	{
+		test_async_source* src;
+		char* buf;
+		size_t len;
+
+		bool await_ready() const { return src->ready; }
+		void await_suspend(std::coroutine_handle<> h) { src->waiting = h; }
+		size_t await_resume()
+		{
+			size_t n = std::min(std::min(len, src->step), src->data.size() - src->pos);
+			memcpy(buf, src->data.data() + src->pos, n);
+			src->pos += n;
+			return n;
+		}
+	};
+
+	read_op read(char* buf, size_t len) { return read_op{ this, buf, len }; }
+
+	bool pump()
+	{
+		if (!waiting)
+			return false;
+		std::exchange(waiting, nullptr).resume();
+		return true;
+	}
+};
+
+struct test_async_task
+{
+	struct promise_type
+	{
+		test_async_task get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+static test_async_task collect_elements(test_async_source& src, std::string& out, int& ret) {
+	auto elements = lept_async_elements(src);
+	while (co_await elements.next())
+		out += elements.value().stringify() + ";";
+	ret = elements.error();
+}
+
+static test_async_task collect_events(test_async_source& src, std::string& out, int& ret) {
+	auto events = lept_async_events(src);
+	while (co_await events.next()) {
+		const lept_event& e = events.value();
+		switch (e.type) {
+			case lept_event::VALUE: out += e.value.stringify(); break;
+			case lept_event::KEY: out += e.value.get_string() + ":"; break;
+			case lept_event::BEGIN_ARRAY: out += "["; break;
+			case lept_event::END_ARRAY: out += "]"; break;
+			case lept_event::BEGIN_OBJECT: out += "{"; break;
+			case lept_event::END_OBJECT: out += "}"; break;
+		}
+		out += " ";
+	}
+	ret = events.error();
+}
+
+static int async_run(bool events, const std::string& json, size_t step, bool ready, std::string& out) {
+	test_async_source src{ json, step, ready };
+	int ret = -1;
+	out.clear();
+	if (events)
+		collect_events(src, out, ret);
+	else
+		collect_elements(src, out, ret);
+	while (src.pump())
+		;
+	return ret;
+}
+
+static void test_async()
+{
+	const char* json = " [1, \"a\\\"]\\u00e9\", {\"k\": [true, null], \"e\": {}}, [], -0.5 ] ";
+	std::string out;
+	for (size_t step : { 1, 3, 7, 4096 }) {
+		for (bool ready : { false, true }) {
+			EXPECT_EQ_INT(LEPT_PARSE_OK, async_run(false, json, step, ready, out));
+			EXPECT_TRUE(out == "1;\"a\\\"]\xC3\xA9\";{\"e\":{},\"k\":[true,null]};[];-0.5;");
+			EXPECT_EQ_INT(LEPT_PARSE_OK, async_run(true, json, step, ready, out));
+			EXPECT_TRUE(out == "[ 1 \"a\\\"]\xC3\xA9\" { k: [ true null ] e: { } } [ ] -0.5 ] ");
+		}
+	}
+
+	/* elements that span many reads, and a document that is not an array */
+	std::string big = "[\"" + std::string(10000, 'x') + "\",{\"n\":[" + std::string(1000, '[') + std::string(1000, ']') + "]}]";
+	EXPECT_EQ_INT(LEPT_PARSE_OK, async_run(false, big, 1000, false, out));
+	EXPECT_EQ_SIZE_T(10003 + 2009, out.size());
+	std::string deep = "[" + std::string(LEPT_PARSE_MAX_DEPTH + 1, '[') + std::string(LEPT_PARSE_MAX_DEPTH + 1, ']') + "]";
+	EXPECT_EQ_INT(LEPT_PARSE_TOO_DEEP, async_run(false, deep, 1000, false, out));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, async_run(false, "{\"a\":1}", 2, false, out));
+	EXPECT_TRUE(out == "{\"a\":1};");
+	EXPECT_EQ_INT(LEPT_PARSE_OK, async_run(true, "\"s\"", 1, false, out));
+	EXPECT_TRUE(out == "\"s\" ");
+
+	/* errors end the sequence with the code parse() gives */
+	const char* bad[] = {
+		"", "[", "[1,", "[1", "{", "{\"a\"", "{\"a\":", "{\"a\":1", "{\"a\":1,", "[1,]", "[}",
+		"{1:2}", "{\"a\" 1}", "[1 2]", "nul", "[tru]", "1 2", "[1-2]", "[\"open", "[1e400]",
+	};
+	lept_value v;
+	for (const char* d : bad) {
+		EXPECT_EQ_INT(v.parse(d), async_run(true, d, 1, false, out));
+		EXPECT_EQ_INT(v.parse(d), async_run(true, d, 2, true, out));
+	}
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, async_run(false, "[1, {\"a\":2}", 1, false, out));
+	EXPECT_TRUE(out == "1;{\"a\":2};");
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, async_run(false, "[1, tru, 3]", 1, false, out));
+	EXPECT_TRUE(out == "1;");
+}
+#endif
 
 static void test_parse() {
 	test_parse_null();
@@ -342,6 +1600,32 @@ static void test_parse() {
 	test_stringify();
 	test_construct();
 	test_template();
+	test_parse_stats();
+	test_memory_usage();
+	test_pack();
+	test_snapshot();
+	test_reader();
+	test_reflect_read();
+	test_reflect_write();
+	test_codegen();
+	test_schema();
+	test_patch();
+	test_diff();
+	test_equal_hash();
+	test_copy_on_write();
+	test_shared_document();
+	test_stringify_parallel();
+	test_utf8();
+	test_stringify_ascii();
+	test_lazy_numbers();
+	test_parse_borrowed();
+	test_pool();
+	test_path();
+	test_parse_mask();
+	test_validate();
+#ifdef LEPT_ASYNC
+	test_async();
+#endif
 }
 
 int main() {